@@ -65,6 +65,13 @@ defs_steppersync = """
         , struct serialqueue *sq, int move_num);
     void steppersync_set_time(struct steppersync *ss
         , double time_offset, double mcu_freq);
+    struct steppersync_stats {
+        int move_count, queue_used;
+        double starve_time, stall_time;
+        uint64_t move_msgs, stall_count;
+    };
+    void steppersync_get_stats(struct steppersync *ss, double print_time
+        , struct steppersync_stats *stats);
     struct steppersyncmgr *steppersyncmgr_alloc(void);
     void steppersyncmgr_free(struct steppersyncmgr *ssm);
     struct steppersync *steppersyncmgr_alloc_steppersync(
@@ -97,15 +104,25 @@ defs_trapq = """
         double x_r, y_r, z_r;
     };
 
+    struct pull_position {
+        double x, y, z, velocity;
+    };
+
     struct trapq *trapq_alloc(void);
     void trapq_free(struct trapq *tq);
+    void trapq_set_accel_order(struct trapq *tq, int accel_order);
     void trapq_append(struct trapq *tq, double print_time
         , double accel_t, double cruise_t, double decel_t
         , double start_pos_x, double start_pos_y, double start_pos_z
         , double axes_r_x, double axes_r_y, double axes_r_z
         , double start_v, double cruise_v, double accel);
+    int trapq_append_batch(struct trapq *tq, double *data, int count
+        , int num_axes, int axis, int mark_xy);
     void trapq_finalize_moves(struct trapq *tq, double print_time
         , double clear_history_time);
+    void trapq_enable_snapshot(struct trapq *tq, int max_moves);
+    int trapq_snapshot_position(struct trapq *tq, double print_time
+        , struct pull_position *p);
     void trapq_set_position(struct trapq *tq, double print_time
         , double pos_x, double pos_y, double pos_z);
     int trapq_extract_old(struct trapq *tq, struct pull_move *p, int max
@@ -206,6 +223,7 @@ defs_serialqueue = """
     void serialqueue_set_clock_est(struct serialqueue *sq, double est_freq
         , double conv_time, uint64_t conv_clock, uint64_t last_clock);
     void serialqueue_get_stats(struct serialqueue *sq, char *buf, int len);
+    int serialqueue_get_ready_bytes(struct serialqueue *sq);
     int serialqueue_extract_old(struct serialqueue *sq, int sentq
         , struct pull_queue_message *q, int max);
 """
@@ -227,6 +245,7 @@ defs_pyhelper = """
     void set_python_logging_callback(void (*func)(const char *));
     double get_monotonic(void);
     int set_thread_name(char name[16]);
+    void seqlock_write(uint32_t *seq, void *dest, const void *src, int len);
 """
 
 defs_std = """
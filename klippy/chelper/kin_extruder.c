@@ -56,6 +56,46 @@ extruder_integrate_time(double base, double start_v, double half_accel
     return ei - si;
 }
 
+// Calculate the definitive integrals of a "smooth" acceleration move:
+//   position(t) = base + t * (c[0] + t * (c[1] + ... + t * c[5]))
+//   weighted_position(t) = t * position(t)
+static double
+extruder_integrate_smooth(double base, double c[6], double start, double end
+                          , double time_offset)
+{
+    double si = 0., ei = 0., swi = 0., ewi = 0.;
+    int i;
+    for (i = 5; i >= 0; i--) {
+        si = (si + c[i] / (i + 2)) * start;
+        ei = (ei + c[i] / (i + 2)) * end;
+        swi = (swi + c[i] / (i + 3)) * start;
+        ewi = (ewi + c[i] / (i + 3)) * end;
+    }
+    si = (si + base) * start;
+    ei = (ei + base) * end;
+    swi = (swi + .5 * base) * start * start;
+    ewi = (ewi + .5 * base) * end * end;
+    return (ewi - swi) - time_offset * (ei - si);
+}
+
+// Calculate the definitive integral of extruder for a "smooth" move
+static double
+pa_smooth_move_integrate(struct move *m, double pressure_advance
+                         , double base, double start, double end
+                         , double time_offset)
+{
+    // Polynomial coefficients of the nominal position
+    double mc[7] = { m->start_v, m->half_accel, m->accel_c[0], m->accel_c[1]
+                     , m->accel_c[2], m->accel_c[3], 0. };
+    // Add pressure_advance * nominal_velocity(t)
+    double c[6];
+    int i;
+    for (i = 0; i < 6; i++)
+        c[i] = mc[i] + pressure_advance * (i + 2) * mc[i + 1];
+    base += pressure_advance * m->start_v;
+    return extruder_integrate_smooth(base, c, start, end, time_offset);
+}
+
 // Calculate the definitive integral of extruder for a given move
 static double
 pa_move_integrate(struct move *m, struct list_head *pa_list
@@ -76,6 +116,9 @@ pa_move_integrate(struct move *m, struct list_head *pa_list
         }
         pressure_advance = pa->pressure_advance;
     }
+    if (unlikely(m->accel_order > 2))
+        return pa_smooth_move_integrate(m, pressure_advance, base
+                                        , start, end, time_offset);
     // Calculate base position and velocity with pressure advance
     base += pressure_advance * m->start_v;
     double start_v = m->start_v + pressure_advance * 2. * m->half_accel;
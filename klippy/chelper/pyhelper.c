@@ -100,3 +100,15 @@ set_thread_name(char name[16])
 {
     return prctl(PR_SET_NAME, name);
 }
+
+// Copy data to a (shared memory) buffer protected by a sequence lock.
+// The sequence is odd while the copy is in progress.
+void __visible
+seqlock_write(uint32_t *seq, void *dest, const void *src, int len)
+{
+    uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+    __atomic_store_n(seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(dest, src, len);
+    __atomic_store_n(seq, s + 2, __ATOMIC_RELEASE);
+}
@@ -1,6 +1,8 @@
 #ifndef PYHELPER_H
 #define PYHELPER_H
 
+#include <stdint.h> // uint32_t
+
 double get_monotonic(void);
 struct timespec fill_time(double time);
 void set_python_logging_callback(void (*func)(const char *));
@@ -8,5 +10,6 @@ void errorf(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
 void report_errno(char *where, int rc);
 char *dump_string(char *outbuf, int outbuf_size, char *inbuf, int inbuf_size);
 int set_thread_name(char name[16]);
+void seqlock_write(uint32_t *seq, void *dest, const void *src, int len);
 
 #endif // pyhelper.h
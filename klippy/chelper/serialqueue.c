@@ -1048,6 +1048,16 @@ serialqueue_get_stats(struct serialqueue *sq, char *buf, int len)
              , stats.ready_bytes, stats.transmit_requests.upcoming_bytes);
 }
 
+// Report the number of bytes waiting for transmission on the serial port
+int __visible
+serialqueue_get_ready_bytes(struct serialqueue *sq)
+{
+    pthread_mutex_lock(&sq->lock);
+    int ready_bytes = sq->ready_bytes;
+    pthread_mutex_unlock(&sq->lock);
+    return ready_bytes;
+}
+
 // Extract old messages stored in the debug queues
 int __visible
 serialqueue_extract_old(struct serialqueue *sq, int sentq
@@ -228,6 +228,8 @@ struct steppersync {
     // Storage for list of pending move clocks
     uint64_t *move_clocks;
     int num_move_clocks;
+    // Move queue statistics
+    uint64_t move_msgs, stall_count, stall_ticks;
 };
 
 // Allocate a new syncemitter instance
@@ -270,6 +272,30 @@ steppersync_set_time(struct steppersync *ss, double time_offset
     }
 }
 
+// Report mcu move queue occupancy and stall statistics at 'print_time'
+void __visible
+steppersync_get_stats(struct steppersync *ss, double print_time
+                      , struct steppersync_stats *stats)
+{
+    uint64_t clock = clock_from_time(&ss->ce, print_time);
+    uint64_t last_clock = clock;
+    int i, count = 0;
+    for (i=0; i<ss->num_move_clocks; i++) {
+        uint64_t mc = ss->move_clocks[i];
+        if (mc > clock)
+            count++;
+        if (mc > last_clock)
+            last_clock = mc;
+    }
+    double inv_freq = ss->ce.est_freq ? 1. / ss->ce.est_freq : 0.;
+    stats->move_count = ss->num_move_clocks;
+    stats->queue_used = count;
+    stats->starve_time = (last_clock - clock) * inv_freq;
+    stats->move_msgs = ss->move_msgs;
+    stats->stall_count = ss->stall_count;
+    stats->stall_time = ss->stall_ticks * inv_freq;
+}
+
 // Implement a binary heap algorithm to track when the next available
 // 'struct move' in the mcu will be available
 static void
@@ -302,6 +328,7 @@ steppersync_flush(struct steppersync *ss, uint64_t move_clock)
     // Order commands by the reqclock of each pending command
     struct list_head msgs;
     list_init(&msgs);
+    uint64_t now_clock = 0;
     for (;;) {
         // Find message with lowest reqclock
         uint64_t req_clock = MAX_CLOCK;
@@ -321,11 +348,24 @@ steppersync_flush(struct steppersync *ss, uint64_t move_clock)
             break;
 
         uint64_t next_avail = ss->move_clocks[0];
-        if (qm->min_clock)
+        if (qm->min_clock) {
             // The qm->min_clock field is overloaded to indicate that
             // the command uses the 'move queue' and to store the time
             // that move queue item becomes available.
             heap_replace(ss, qm->min_clock);
+            // Track commands that must wait for a free mcu move queue slot
+            ss->move_msgs++;
+            if (!now_clock) {
+                struct clock_estimate ce;
+                serialqueue_get_clock_est(ss->sq, &ce);
+                now_clock = ce.est_freq ? clock_from_time(
+                    &ce, get_monotonic()) : UINT64_MAX;
+            }
+            if (next_avail > now_clock) {
+                ss->stall_count++;
+                ss->stall_ticks += next_avail - now_clock;
+            }
+        }
         // Reset the min_clock to its normal meaning (minimum transmit time)
         qm->min_clock = next_avail;
 
@@ -19,6 +19,13 @@ void steppersync_setup_movequeue(struct steppersync *ss, struct serialqueue *sq
                                  , int move_num);
 void steppersync_set_time(struct steppersync *ss, double time_offset
                           , double mcu_freq);
+struct steppersync_stats {
+    int move_count, queue_used;
+    double starve_time, stall_time;
+    uint64_t move_msgs, stall_count;
+};
+void steppersync_get_stats(struct steppersync *ss, double print_time
+                           , struct steppersync_stats *stats);
 
 struct steppersyncmgr *steppersyncmgr_alloc(void);
 void steppersyncmgr_free(struct steppersyncmgr *ssm);
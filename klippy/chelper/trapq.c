@@ -24,7 +24,42 @@ move_alloc(void)
 inline double
 move_get_distance(struct move *m, double move_time)
 {
-    return (m->start_v + m->half_accel * move_time) * move_time;
+    if (likely(m->accel_order <= 2))
+        return (m->start_v + m->half_accel * move_time) * move_time;
+    double *c = m->accel_c, t = move_time;
+    return (((((c[3] * t + c[2]) * t + c[1]) * t + c[0]) * t
+             + m->half_accel) * t + m->start_v) * t;
+}
+
+// Return the average acceleration of a move
+static double
+move_get_avg_accel(struct move *m)
+{
+    double accel = 2. * m->half_accel;
+    if (likely(m->accel_order <= 2))
+        return accel;
+    double *c = m->accel_c, t = m->move_t;
+    return accel + (((6. * c[3] * t + 5. * c[2]) * t + 4. * c[1]) * t
+                    + 3. * c[0]) * t;
+}
+
+// Return the velocity given a time in a move
+static double
+move_get_velocity(struct move *m, double move_time)
+{
+    double velocity = m->start_v + 2. * m->half_accel * move_time;
+    if (likely(m->accel_order <= 2))
+        return velocity;
+    double *c = m->accel_c, t = move_time;
+    return velocity + (((6. * c[3] * t + 5. * c[2]) * t + 4. * c[1]) * t
+                       + 3. * c[0]) * t * t;
+}
+
+// Check if a move is a placeholder that does not cause any movement
+static inline int
+move_is_null(struct move *m)
+{
+    return !m->start_v && !m->half_accel && m->accel_order <= 2;
 }
 
 // Return the XYZ coordinates given a time in a move
@@ -70,6 +105,7 @@ trapq_free(struct trapq *tq)
         list_del(&m->node);
         free(m);
     }
+    free(tq->snap_moves);
     free(tq);
 }
 
@@ -92,6 +128,39 @@ trapq_check_sentinels(struct trapq *tq)
     tail_sentinel->start_pos = move_get_coord(m, m->move_t);
 }
 
+// The move snapshot is a ring buffer with copies of recent moves that
+// other threads may read without taking a lock.  Only the main thread
+// updates it; readers retry if 'snap_seq' is odd or changes while they
+// copy a move (a "seqlock").
+static void
+snap_write_begin(struct trapq *tq)
+{
+    __atomic_store_n(&tq->snap_seq, tq->snap_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+snap_write_end(struct trapq *tq)
+{
+    __atomic_store_n(&tq->snap_seq, tq->snap_seq + 1, __ATOMIC_RELEASE);
+}
+
+// Add a copy of a move to the snapshot (keeping it sorted by time)
+static void
+snap_push(struct trapq *tq, struct move *m)
+{
+    while (tq->snap_head != tq->snap_tail) {
+        uint32_t last = (tq->snap_head - 1) & tq->snap_mask;
+        if (tq->snap_moves[last].print_time <= m->print_time)
+            break;
+        tq->snap_head--;
+    }
+    tq->snap_moves[tq->snap_head & tq->snap_mask] = *m;
+    tq->snap_head++;
+    if (tq->snap_head - tq->snap_tail > tq->snap_mask + 1)
+        tq->snap_tail++;
+}
+
 #define MAX_NULL_MOVE 1.0
 
 // Add a move to the trapezoid velocity queue
@@ -114,6 +183,47 @@ trapq_add_move(struct trapq *tq, struct move *m)
     }
     list_add_before(&m->node, &tail_sentinel->node);
     tail_sentinel->print_time = 0.;
+    if (tq->snap_moves) {
+        snap_write_begin(tq);
+        snap_push(tq, m);
+        snap_write_end(tq);
+    }
+}
+
+// Set the acceleration profile used for moves added via trapq_append()
+void __visible
+trapq_set_accel_order(struct trapq *tq, int accel_order)
+{
+    tq->accel_order = accel_order;
+}
+
+// Fill the acceleration terms of an acceleration or deceleration move
+//
+// With the default accel_order=2 the move has constant acceleration.
+// The higher orders use "bezier" curves where the acceleration starts
+// and ends at zero.  The move has the same duration, distance, start
+// velocity, and end velocity as with constant acceleration; the peak
+// acceleration is 1.5 (accel_order=4) or 1.875 (accel_order=6) times
+// the average acceleration.
+static void
+move_fill_accel(struct move *m, int accel_order, double accel)
+{
+    if (accel_order <= 2) {
+        m->half_accel = .5 * accel;
+        return;
+    }
+    double inv_t = 1. / m->move_t;
+    double accel_t1 = accel * inv_t, accel_t2 = accel_t1 * inv_t;
+    m->accel_order = accel_order;
+    if (accel_order == 4) {
+        m->accel_c[0] = accel_t1;
+        m->accel_c[1] = -.5 * accel_t2;
+        return;
+    }
+    double accel_t3 = accel_t2 * inv_t, accel_t4 = accel_t3 * inv_t;
+    m->accel_c[1] = 2.5 * accel_t2;
+    m->accel_c[2] = -3. * accel_t3;
+    m->accel_c[3] = accel_t4;
 }
 
 // Fill and add a move to the trapezoid velocity queue
@@ -131,7 +241,7 @@ trapq_append(struct trapq *tq, double print_time
         m->print_time = print_time;
         m->move_t = accel_t;
         m->start_v = start_v;
-        m->half_accel = .5 * accel;
+        move_fill_accel(m, tq->accel_order, accel);
         m->start_pos = start_pos;
         m->axes_r = axes_r;
         trapq_add_move(tq, m);
@@ -157,13 +267,45 @@ trapq_append(struct trapq *tq, double print_time
         m->print_time = print_time;
         m->move_t = decel_t;
         m->start_v = cruise_v;
-        m->half_accel = -.5 * accel;
+        move_fill_accel(m, tq->accel_order, -accel);
         m->start_pos = start_pos;
         m->axes_r = axes_r;
         trapq_add_move(tq, m);
     }
 }
 
+// Add a batch of toolhead moves to the trapq of an extra axis
+//
+// The 'data' array contains 'count' moves.  Each move is stored as
+// TQB_MOVE_FIELDS values (print_time, accel_t, cruise_t, decel_t,
+// start_v, cruise_v, accel) followed by 'num_axes' start positions
+// and then 'num_axes' axis ratios.  Moves that do not involve 'axis'
+// are skipped.  If 'mark_xy' is set then axes_r.y is set to 1.0 on
+// moves with positive axis movement that also move in XY (as used by
+// the extruder pressure advance code).  Returns the index of the last
+// move added (or -1 if no moves were added).
+int __visible
+trapq_append_batch(struct trapq *tq, double *data, int count, int num_axes
+                   , int axis, int mark_xy)
+{
+    int stride = TQB_MOVE_FIELDS + 2*num_axes, last = -1, i;
+    for (i=0; i<count; i++, data += stride) {
+        double *start_pos = &data[TQB_MOVE_FIELDS];
+        double *axes_r = &start_pos[num_axes];
+        double axis_r = axes_r[axis];
+        if (!axis_r)
+            continue;
+        double flag_xy = 0.;
+        if (mark_xy && axis_r > 0. && (axes_r[0] || axes_r[1]))
+            flag_xy = 1.;
+        trapq_append(tq, data[0], data[1], data[2], data[3]
+                     , start_pos[axis], 0., 0., 1., flag_xy, 0.
+                     , data[4] * axis_r, data[5] * axis_r, data[6] * axis_r);
+        last = i;
+    }
+    return last;
+}
+
 // Expire any moves older than `print_time` from the trapezoid velocity queue
 void __visible
 trapq_finalize_moves(struct trapq *tq, double print_time
@@ -181,7 +323,7 @@ trapq_finalize_moves(struct trapq *tq, double print_time
         if (m->print_time + m->move_t > print_time)
             break;
         list_del(&m->node);
-        if (m->start_v || m->half_accel)
+        if (!move_is_null(m))
             list_add_head(&m->node, &tq->history);
         else
             free(m);
@@ -226,6 +368,98 @@ trapq_set_position(struct trapq *tq, double print_time
     m->start_pos.y = pos_y;
     m->start_pos.z = pos_z;
     list_add_head(&m->node, &tq->history);
+
+    // Apply the same changes to the move snapshot
+    if (!tq->snap_moves)
+        return;
+    snap_write_begin(tq);
+    while (tq->snap_head != tq->snap_tail) {
+        struct move *sm = &tq->snap_moves[(tq->snap_head - 1) & tq->snap_mask];
+        if (sm->print_time < print_time) {
+            if (sm->print_time + sm->move_t > print_time)
+                sm->move_t = print_time - sm->print_time;
+            break;
+        }
+        tq->snap_head--;
+    }
+    snap_push(tq, m);
+    snap_write_end(tq);
+}
+
+// Start tracking a snapshot of (at least) the last 'max_moves' moves
+void __visible
+trapq_enable_snapshot(struct trapq *tq, int max_moves)
+{
+    if (tq->snap_moves)
+        return;
+    uint32_t size = 1;
+    while (size < max_moves)
+        size <<= 1;
+    snap_write_begin(tq);
+    tq->snap_moves = malloc(sizeof(*tq->snap_moves) * size);
+    memset(tq->snap_moves, 0, sizeof(*tq->snap_moves) * size);
+    tq->snap_mask = size - 1;
+    tq->snap_head = tq->snap_tail = 0;
+    // Populate with the existing history and pending moves
+    struct move *m;
+    list_for_each_entry_reverse(m, &tq->history, node) {
+        snap_push(tq, m);
+    }
+    list_for_each_entry(m, &tq->moves, node) {
+        if (!move_is_null(m))
+            snap_push(tq, m);
+    }
+    snap_write_end(tq);
+}
+
+// Determine the requested position and velocity at 'print_time'
+//
+// This reads the move snapshot and may be called from any thread
+// (without blocking the main thread).  Returns 0 if no move at or
+// prior to 'print_time' is available.
+int __visible
+trapq_snapshot_position(struct trapq *tq, double print_time
+                        , struct pull_position *p)
+{
+    struct move m = { .print_time = 0. };
+    for (;;) {
+        uint32_t seq = __atomic_load_n(&tq->snap_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        struct move *moves = tq->snap_moves;
+        if (!moves)
+            return 0;
+        uint32_t tail = tq->snap_tail, mask = tq->snap_mask;
+        uint32_t count = tq->snap_head - tail;
+        if (count > mask + 1)
+            continue;
+        // Binary search for the last move starting at or before print_time
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (moves[(tail + mid) & mask].print_time <= print_time)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo)
+            m = moves[(tail + lo - 1) & mask];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&tq->snap_seq, __ATOMIC_RELAXED) != seq)
+            continue;
+        if (!lo)
+            return 0;
+        break;
+    }
+    double move_time = print_time - m.print_time;
+    if (move_time > m.move_t)
+        move_time = m.move_t;
+    struct coord c = move_get_coord(&m, move_time);
+    p->x = c.x;
+    p->y = c.y;
+    p->z = c.z;
+    p->velocity = move_get_velocity(&m, move_time);
+    return 1;
 }
 
 // Copy the info in a 'struct move' to a 'struct pull_move'
@@ -235,7 +469,7 @@ copy_pull_move(struct pull_move *p, struct move *m)
     p->print_time = m->print_time;
     p->move_t = m->move_t;
     p->start_v = m->start_v;
-    p->accel = 2. * m->half_accel;
+    p->accel = move_get_avg_accel(m);
     p->start_x = m->start_pos.x;
     p->start_y = m->start_pos.y;
     p->start_z = m->start_pos.z;
@@ -254,7 +488,7 @@ trapq_extract_old(struct trapq *tq, struct pull_move *p, int max
     list_for_each_entry_reverse(m, &tq->moves, node) {
         if (start_time >= m->print_time + m->move_t || res >= max)
             break;
-        if (end_time <= m->print_time || (!m->start_v && !m->half_accel))
+        if (end_time <= m->print_time || move_is_null(m))
             continue;
         copy_pull_move(p, m);
         p++;
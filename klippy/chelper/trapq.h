@@ -1,6 +1,7 @@
 #ifndef TRAPQ_H
 #define TRAPQ_H
 
+#include <stdint.h> // uint32_t
 #include "list.h" // list_node
 
 struct coord {
@@ -15,6 +16,9 @@ struct coord {
 struct move {
     double print_time, move_t;
     double start_v, half_accel;
+    // Higher order (t^3 .. t^6) terms for "smooth" acceleration moves
+    int accel_order;
+    double accel_c[4];
     struct coord start_pos, axes_r;
 
     struct list_node node;
@@ -22,6 +26,10 @@ struct move {
 
 struct trapq {
     struct list_head moves, history;
+    int accel_order;
+    // Seqlock protected copy of recent moves (for readers in other threads)
+    struct move *snap_moves;
+    uint32_t snap_seq, snap_mask, snap_head, snap_tail;
 };
 
 struct pull_move {
@@ -31,6 +39,13 @@ struct pull_move {
     double x_r, y_r, z_r;
 };
 
+struct pull_position {
+    double x, y, z, velocity;
+};
+
+// Number of per-move values in a trapq_append_batch() data array
+#define TQB_MOVE_FIELDS 7
+
 struct move *move_alloc(void);
 double move_get_distance(struct move *m, double move_time);
 struct coord move_get_coord(struct move *m, double move_time);
@@ -38,13 +53,19 @@ struct trapq *trapq_alloc(void);
 void trapq_free(struct trapq *tq);
 void trapq_check_sentinels(struct trapq *tq);
 void trapq_add_move(struct trapq *tq, struct move *m);
+void trapq_set_accel_order(struct trapq *tq, int accel_order);
 void trapq_append(struct trapq *tq, double print_time
                   , double accel_t, double cruise_t, double decel_t
                   , double start_pos_x, double start_pos_y, double start_pos_z
                   , double axes_r_x, double axes_r_y, double axes_r_z
                   , double start_v, double cruise_v, double accel);
+int trapq_append_batch(struct trapq *tq, double *data, int count, int num_axes
+                       , int axis, int mark_xy);
 void trapq_finalize_moves(struct trapq *tq, double print_time
                           , double clear_history_time);
+void trapq_enable_snapshot(struct trapq *tq, int max_moves);
+int trapq_snapshot_position(struct trapq *tq, double print_time
+                            , struct pull_position *p);
 void trapq_set_position(struct trapq *tq, double print_time
                         , double pos_x, double pos_y, double pos_z);
 int trapq_extract_old(struct trapq *tq, struct pull_move *p, int max
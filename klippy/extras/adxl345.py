@@ -4,7 +4,7 @@
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
 import logging, time, collections, multiprocessing, os
-from . import bus, bulk_sensor
+from . import bus, bulk_sensor, sos_filter
 
 # ADXL345 registers
 REG_DEVID = 0x00
@@ -23,6 +23,12 @@ QUERY_RATES = {
 ADXL345_DEV_ID = 0xe5
 SET_FIFO_CTL = 0x90
 
+# Value reported for all axes of a sample with a data error (delta packing)
+DELTA_ERROR = -0x8000
+
+# Number of initial decimated samples discarded while the filter settles
+DECIMATE_SETTLE_SAMPLES = 8
+
 FREEFALL_ACCEL = 9.80665 * 1000.
 SCALE_XY = 0.003774 * FREEFALL_ACCEL # 1 / 265 (at 3.3V) mg/LSB
 SCALE_Z  = 0.003906 * FREEFALL_ACCEL # 1 / 256 (at 3.3V) mg/LSB
@@ -200,10 +206,25 @@ class ADXL345:
         self.mcu = mcu = self.spi.get_mcu()
         self.oid = oid = mcu.create_oid()
         self.query_adxl345_cmd = None
+        self.delta_packing = False
         mcu.add_config_cmd("config_adxl345 oid=%d spi_oid=%d"
                            % (oid, self.spi.get_oid()))
-        mcu.add_config_cmd("query_adxl345 oid=%d rest_ticks=0"
-                           % (oid,), on_restart=True)
+        # Optional on-mcu lowpass filter and decimation
+        self.decimation = config.getint('decimation', 1, minval=1, maxval=8)
+        self.decimate_filters = []
+        self.decimate_skip = 0
+        if self.decimation > 1:
+            # Lowpass at 80% of the decimated nyquist frequency
+            cutoff = .4 * self.data_rate / self.decimation
+            sections = sos_filter.butter_lowpass_sections(cutoff,
+                                                          self.data_rate)
+            fixed_filter = sos_filter.FixedPointSosFilter(
+                sections, [[0., 0.]] * len(sections))
+            cmdqueue = self.spi.get_command_queue()
+            for i in range(3):
+                sf = sos_filter.SosFilter(mcu, cmdqueue, fixed_filter)
+                sf.create_filter()
+                self.decimate_filters.append(sf)
         mcu.register_config_callback(self._build_config)
         # Bulk sample message reading
         chip_smooth = self.data_rate * BATCH_UPDATES * 2
@@ -219,10 +240,35 @@ class ADXL345:
                                          self.name, {'header': hdr})
     def _build_config(self):
         cmdqueue = self.spi.get_command_queue()
-        self.query_adxl345_cmd = self.mcu.lookup_command(
-            "query_adxl345 oid=%c rest_ticks=%u", cq=cmdqueue)
+        # Use delta packed sample reports if supported by the mcu
+        self.query_adxl345_cmd = self.mcu.try_lookup_command(
+            "query_adxl345 oid=%c rest_ticks=%u delta_packing=%c", cq=cmdqueue)
+        if self.query_adxl345_cmd is not None:
+            self.delta_packing = True
+            self.mcu.add_config_cmd(
+                "query_adxl345 oid=%d rest_ticks=0 delta_packing=0"
+                % (self.oid,), on_restart=True)
+        else:
+            self.query_adxl345_cmd = self.mcu.lookup_command(
+                "query_adxl345 oid=%c rest_ticks=%u", cq=cmdqueue)
+            self.mcu.add_config_cmd("query_adxl345 oid=%d rest_ticks=0"
+                                    % (self.oid,), on_restart=True)
+        if self.decimate_filters:
+            if (not self.delta_packing or self.mcu.try_lookup_command(
+                    "adxl345_set_decimation oid=%c factor=%c x_filter_oid=%c"
+                    " y_filter_oid=%c z_filter_oid=%c") is None):
+                raise self.printer.config_error(
+                    "MCU '%s' does not support adxl345 decimation"
+                    % (self.mcu.get_name(),))
+            foids = [sf.get_oid() for sf in self.decimate_filters]
+            self.mcu.add_config_cmd(
+                "adxl345_set_decimation oid=%d factor=%d x_filter_oid=%d"
+                " y_filter_oid=%d z_filter_oid=%d"
+                % tuple([self.oid, self.decimation] + foids))
         self.ffreader.setup_query_command("query_adxl345_status oid=%c",
-                                          oid=self.oid, cq=cmdqueue)
+                                          oid=self.oid, cq=cmdqueue,
+                                          delta_fields=3*self.delta_packing,
+                                          decimation=self.decimation)
     def read_reg(self, reg):
         params = self.spi.spi_transfer([reg | REG_MOD_READ, 0x00])
         response = bytearray(params['response'])
@@ -242,6 +288,9 @@ class ADXL345:
         return aqh
     # Measurement decoding
     def _convert_samples(self, samples):
+        if self.delta_packing:
+            self._convert_delta_samples(samples)
+            return
         (x_pos, x_scale), (y_pos, y_scale), (z_pos, z_scale) = self.axes_map
         count = 0
         for ptime, xlow, ylow, zlow, xzhigh, yzhigh in samples:
@@ -259,6 +308,25 @@ class ADXL345:
             samples[count] = (round(ptime, 6), x, y, z)
             count += 1
         del samples[count:]
+    def _convert_delta_samples(self, samples):
+        (x_pos, x_scale), (y_pos, y_scale), (z_pos, z_scale) = self.axes_map
+        if self.decimate_skip:
+            # Discard samples taken while the mcu filter settles
+            skip = min(self.decimate_skip, len(samples))
+            del samples[:skip]
+            self.decimate_skip -= skip
+        count = 0
+        for ptime, rx, ry, rz in samples:
+            if rx == DELTA_ERROR:
+                self.last_error_count += 1
+                continue
+            raw_xyz = (rx, ry, rz)
+            x = round(raw_xyz[x_pos] * x_scale, 6)
+            y = round(raw_xyz[y_pos] * y_scale, 6)
+            z = round(raw_xyz[z_pos] * z_scale, 6)
+            samples[count] = (round(ptime, 6), x, y, z)
+            count += 1
+        del samples[count:]
     # Start, stop, and process message batches
     def _start_measurements(self):
         # In case of miswiring, testing ADXL345 device ID prevents treating
@@ -277,8 +345,13 @@ class ADXL345:
         self.set_reg(REG_BW_RATE, QUERY_RATES[self.data_rate])
         self.set_reg(REG_FIFO_CTL, SET_FIFO_CTL)
         # Start bulk reading
+        for sf in self.decimate_filters:
+            sf.reset_filter()
+        if self.decimate_filters:
+            self.decimate_skip = DECIMATE_SETTLE_SAMPLES
         rest_ticks = self.mcu.seconds_to_clock(4. / self.data_rate)
-        self.query_adxl345_cmd.send([self.oid, rest_ticks])
+        self.query_adxl345_cmd.send([self.oid, rest_ticks]
+                                    + [1] * self.delta_packing)
         self.set_reg(REG_POWER_CTL, 0x08)
         logging.info("ADXL345 starting '%s' measurements", self.name)
         # Initialize clock tracking
@@ -287,7 +360,8 @@ class ADXL345:
     def _finish_measurements(self):
         # Halt bulk reading
         self.set_reg(REG_POWER_CTL, 0x00)
-        self.query_adxl345_cmd.send_wait_ack([self.oid, 0])
+        self.query_adxl345_cmd.send_wait_ack([self.oid, 0]
+                                             + [0] * self.delta_packing)
         self.ffreader.note_end()
         logging.info("ADXL345 finished '%s' measurements", self.name)
     def _process_batch(self, eventtime):
@@ -4,6 +4,7 @@
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
 import logging, math, json, collections
+import workerpool
 from . import probe
 
 PROFILE_VERSION = 1
@@ -772,8 +773,9 @@ class BedMeshCalibrate:
                     (len(probed_matrix), str(probed_matrix)))
 
         z_mesh = ZMesh(params, self._profile_name)
+        pool = workerpool.get_worker_pool(self.printer)
         try:
-            z_mesh.build_mesh(probed_matrix)
+            z_mesh.build_mesh(probed_matrix, pool)
         except BedMeshError as e:
             raise self.gcode.error(str(e))
         if self.probe_mgr.get_zero_ref_mode() == ZrefMode.IN_MESH:
@@ -1402,10 +1404,18 @@ class ZMesh:
             print_func(msg)
         else:
             print_func("bed_mesh: Z Mesh not generated")
-    def build_mesh(self, z_matrix):
+    def build_mesh(self, z_matrix, worker_pool=None):
         self.probed_matrix = z_matrix
-        self._sample(z_matrix)
+        if worker_pool is None or self.mesh_params['algo'] == 'direct':
+            self._sample(z_matrix)
+        else:
+            # Interpolate the mesh in a background process
+            self.mesh_matrix = worker_pool.run(self._calc_mesh_matrix,
+                                               (z_matrix,))
         self.print_mesh(logging.debug)
+    def _calc_mesh_matrix(self, z_matrix):
+        self._sample(z_matrix)
+        return self.mesh_matrix
     def set_zero_reference(self, xpos, ypos):
         offset = self.calc_z(xpos, ypos)
         logging.info(
@@ -3,7 +3,8 @@
 # Copyright (C) 2020-2023  Kevin O'Connor <kevin@koconnor.net>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
-import logging, threading, struct
+import logging, threading, struct, itertools
+import webhooks
 
 # This "bulk sensor" module facilitates the processing of sensor chip
 # measurements that do not require the host to respond with low
@@ -104,12 +105,49 @@ class BatchWebhooksClient:
     def __init__(self, web_request):
         self.cconn = web_request.get_client_connection()
         self.template = web_request.get_dict('response_template', {})
+        data_format = web_request.get_str('data_format', 'json')
+        if data_format not in ['json', 'binary']:
+            raise web_request.error("Invalid data_format '%s'"
+                                    % (data_format,))
+        self.is_binary = data_format == 'binary'
+        self.dropped_batches = 0
+    def _pack_binary(self, msg):
+        params = dict(msg)
+        rows = params.get('data', [])
+        values = []
+        columns = 0
+        if rows:
+            if any([isinstance(v, (tuple, list)) for v in rows[0]]):
+                # Flatten nested values (eg, trapq positions)
+                rows = [[x for v in r for x in (
+                    v if isinstance(v, (tuple, list)) else (v,))]
+                        for r in rows]
+            columns = len(rows[0])
+            values = list(itertools.chain.from_iterable(rows))
+            if len(values) != len(rows) * columns:
+                raise ValueError("Bulk data rows are not of equal length")
+        params['data'] = {'type': 'float64', 'rows': len(rows),
+                          'columns': columns}
+        tmp = dict(self.template)
+        tmp['params'] = params
+        return tmp, struct.pack('<%dd' % (len(values),), *values)
     def handle_batch(self, msg):
         if self.cconn.is_closed():
             return False
-        tmp = dict(self.template)
-        tmp['params'] = msg
-        self.cconn.send(tmp)
+        if self.dropped_batches:
+            # Report batches discarded since the last delivered batch
+            msg = dict(msg)
+            msg['dropped_batches'] = self.dropped_batches
+        if self.is_binary:
+            tmp = webhooks.BinaryMessage(lambda: self._pack_binary(msg))
+        else:
+            tmp = dict(self.template)
+            tmp['params'] = msg
+        # Batches may be discarded if the client is not keeping up
+        if self.cconn.send(tmp, droppable=True):
+            self.dropped_batches = 0
+        else:
+            self.dropped_batches += 1
         return True
 
 # Helper class to store incoming messages in a queue
@@ -200,6 +238,37 @@ class ClockSyncRegression:
 
 MAX_BULK_MSG_SIZE = 51
 
+# Bit widths selected by the 2-bit code of each delta packed sample
+DELTA_WIDTHS = [4, 7, 10, 16]
+
+# Decode the samples in a sensor_bulk_delta message
+def decode_delta_samples(data, count, fields):
+    samples = [None] * count
+    last = [0] * fields
+    acc = acc_bits = pos = 0
+    for s in range(count):
+        if acc_bits < 2:
+            acc |= data[pos] << acc_bits
+            acc_bits += 8
+            pos += 1
+        width = DELTA_WIDTHS[acc & 0x03]
+        acc >>= 2
+        acc_bits -= 2
+        mask = (1 << width) - 1
+        sign = 1 << (width - 1)
+        for i in range(fields):
+            while acc_bits < width:
+                acc |= data[pos] << acc_bits
+                acc_bits += 8
+                pos += 1
+            diff = acc & mask
+            acc >>= width
+            acc_bits -= width
+            val = last[i] + diff - ((diff & sign) << 1)
+            last[i] = ((val + 0x8000) & 0xffff) - 0x8000
+        samples[s] = tuple(last)
+    return samples
+
 # Read sensor_bulk_data and calculate timestamps for devices that take
 # samples at a fixed frequency (and produce fixed data size samples).
 class FixedFreqReader:
@@ -210,10 +279,13 @@ class FixedFreqReader:
         self.unpack_from = unpack.unpack_from
         self.bytes_per_sample = unpack.size
         self.samples_per_block = MAX_BULK_MSG_SIZE // self.bytes_per_sample
+        self.delta_fields = 0
+        self.decimation = 1
         self.last_sequence = self.max_query_duration = 0
         self.last_overflows = 0
         self.bulk_queue = self.oid = self.query_status_cmd = None
-    def setup_query_command(self, msgformat, oid, cq):
+    def setup_query_command(self, msgformat, oid, cq, delta_fields=0,
+                            decimation=1):
         # Lookup sensor query command (that responds with sensor_bulk_status)
         self.oid = oid
         self.query_status_cmd = self.mcu.lookup_query_command(
@@ -221,7 +293,15 @@ class FixedFreqReader:
             " next_sequence=%hu buffered=%u possible_overflows=%hu",
             oid=oid, cq=cq)
         # Read sensor_bulk_data messages and store in a queue
-        self.bulk_queue = BulkDataQueue(self.mcu, oid=oid)
+        msg_name = "sensor_bulk_data"
+        if delta_fields:
+            # Delta packed messages (sequence is the index of the first
+            # chip sample and each sample covers 'decimation' chip samples)
+            msg_name = "sensor_bulk_delta"
+            self.delta_fields = delta_fields
+            self.decimation = decimation
+            self.samples_per_block = 1
+        self.bulk_queue = BulkDataQueue(self.mcu, msg_name, oid=oid)
     def get_last_overflows(self):
         return self.last_overflows
     def _clear_duration_filter(self):
@@ -272,6 +352,8 @@ class FixedFreqReader:
         raw_samples = self.bulk_queue.pull_queue()
         if not raw_samples:
             return []
+        if self.delta_fields:
+            return self._pull_delta_samples(raw_samples)
         # Load variables to optimize inner loop below
         last_sequence = self.last_sequence
         time_base, chip_base, inv_freq = self.clock_sync.get_time_translation()
@@ -295,3 +377,25 @@ class FixedFreqReader:
         self.clock_sync.set_last_chip_clock(seq * samples_per_block + i)
         del samples[count:]
         return samples
+    # Convert sensor_bulk_delta responses into list of samples
+    def _pull_delta_samples(self, raw_samples):
+        last_sequence = self.last_sequence
+        time_base, chip_base, inv_freq = self.clock_sync.get_time_translation()
+        fields = self.delta_fields
+        # A decimated sample is reported with the last chip sample it covers
+        decimation = self.decimation
+        samples = []
+        seq = 0
+        for params in raw_samples:
+            seq_diff = (params['sequence'] - last_sequence) & 0xffff
+            seq_diff -= (seq_diff & 0x8000) << 1
+            seq = last_sequence + seq_diff
+            msg_cdiff = seq - chip_base + decimation - 1
+            msg_samples = decode_delta_samples(bytearray(params['data']),
+                                               params['count'], fields)
+            for i, vals in enumerate(msg_samples):
+                ptime = time_base + (msg_cdiff + i * decimation) * inv_freq
+                samples.append((ptime,) + vals)
+            seq += len(msg_samples) * decimation
+        self.clock_sync.set_last_chip_clock(seq - 1)
+        return samples
@@ -0,0 +1,59 @@
+# Support for sampling several endstops from a single mcu timer
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+
+class EndstopGroup:
+    def __init__(self, config):
+        self.printer = config.get_printer()
+        self.name = config.get_name()
+        self.endstop_names = config.getlist('endstops')
+        if len(self.endstop_names) < 2:
+            raise config.error("Option 'endstops' in section '%s' must"
+                               " specify at least two endstops" % (self.name,))
+        self.mcu = self.oid = None
+        self.endstops = []
+        self.query_endstops = self.printer.load_object(config,
+                                                       'query_endstops')
+        self.printer.register_event_handler("klippy:mcu_identify",
+                                            self._handle_mcu_identify)
+    def _lookup_endstop(self, name):
+        for mcu_endstop, ename in self.query_endstops.endstops:
+            if ename == name:
+                if not hasattr(mcu_endstop, 'get_oid'):
+                    raise self.printer.config_error(
+                        "Endstop '%s' in '%s' is not a micro-controller"
+                        " endstop pin" % (name, self.name))
+                return mcu_endstop
+        raise self.printer.config_error("Unknown endstop '%s' in '%s'"
+                                        % (name, self.name))
+    def _handle_mcu_identify(self):
+        for ename in self.endstop_names:
+            mcu_endstop = self._lookup_endstop(ename)
+            if mcu_endstop in self.endstops:
+                raise self.printer.config_error(
+                    "Endstop %s specified twice in '%s'" % (ename, self.name))
+            self.endstops.append(mcu_endstop)
+        self.mcu = self.endstops[0].get_mcu()
+        for mcu_endstop in self.endstops:
+            if mcu_endstop.get_mcu() is not self.mcu:
+                raise self.printer.config_error(
+                    "All endstops in '%s' must be on the same mcu"
+                    % (self.name,))
+        if self.mcu.try_lookup_command(
+                "endstop_group_add oid=%c endstop_oid=%c") is None:
+            raise self.printer.config_error(
+                "MCU '%s' does not support endstop groups"
+                % (self.mcu.get_name(),))
+        self.oid = self.mcu.create_oid()
+        self.mcu.register_config_callback(self._build_config)
+    def _build_config(self):
+        self.mcu.add_config_cmd("config_endstop_group oid=%d endstop_count=%d"
+                                % (self.oid, len(self.endstops)))
+        for mcu_endstop in self.endstops:
+            self.mcu.add_config_cmd("endstop_group_add oid=%d endstop_oid=%d"
+                                    % (self.oid, mcu_endstop.get_oid()))
+
+def load_config_prefix(config):
+    return EndstopGroup(config)
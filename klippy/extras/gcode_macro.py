@@ -11,12 +11,59 @@ import jinja2
 # Template handling
 ######################################################################
 
+# Read-only containers used for printer status snapshots
+def _read_only(*args, **kwargs):
+    raise TypeError("Printer status is read-only")
+
+class FrozenDict(dict):
+    __setitem__ = __delitem__ = _read_only
+    clear = pop = popitem = setdefault = update = _read_only
+    __ior__ = _read_only
+    # Copies (and pickles) of a read-only container are regular dicts
+    def __copy__(self):
+        return dict(self)
+    def __reduce__(self):
+        return (dict, (dict(self),))
+    def __deepcopy__(self, memo):
+        return {k: copy.deepcopy(v, memo) for k, v in self.items()}
+
+class FrozenList(list):
+    __setitem__ = __delitem__ = __iadd__ = __imul__ = _read_only
+    append = clear = extend = insert = pop = remove = _read_only
+    reverse = sort = _read_only
+    def __copy__(self):
+        return list(self)
+    def __reduce__(self):
+        return (list, (list(self),))
+    def __deepcopy__(self, memo):
+        return [copy.deepcopy(v, memo) for v in self]
+
+IMMUTABLE_TYPES = (str, int, float, bool, type(None))
+
+# Create a read-only copy of a get_status() result
+def freeze_status(val):
+    if isinstance(val, IMMUTABLE_TYPES):
+        return val
+    if isinstance(val, dict):
+        return FrozenDict([(k, freeze_status(v)) for k, v in val.items()])
+    if isinstance(val, list):
+        return FrozenList([freeze_status(v) for v in val])
+    if isinstance(val, tuple):
+        if all([isinstance(v, IMMUTABLE_TYPES) for v in val]):
+            return val
+        items = [freeze_status(v) for v in val]
+        if hasattr(val, '_fields'):
+            return type(val)(*items)
+        return tuple(items)
+    return copy.deepcopy(val)
+
 # Wrapper for access to printer object get_status() methods
 class GetStatusWrapper:
     def __init__(self, printer, eventtime=None):
         self.printer = printer
         self.eventtime = eventtime
         self.cache = {}
+        self.snapshots = printer.lookup_object('gcode_macro').status_snapshots
     def __getitem__(self, val):
         sval = str(val).strip()
         if sval in self.cache:
@@ -27,9 +74,7 @@ class GetStatusWrapper:
         reactor = self.printer.get_reactor()
         if self.eventtime is None:
             self.eventtime = reactor.monotonic()
-        with reactor.assert_no_pause():
-            sts = po.get_status(self.eventtime)
-        self.cache[sval] = res = copy.deepcopy(sts)
+        self.cache[sval] = res = self.snapshots.get(sval, po, self.eventtime)
         return res
     def __contains__(self, val):
         try:
@@ -42,6 +87,51 @@ class GetStatusWrapper:
             if self.__contains__(name):
                 yield name
 
+# Cache of read-only get_status() snapshots shared by all templates.  A
+# snapshot is reused while an object returns the same (immutable)
+# get_status() result or reports the same get_status_version().
+class StatusSnapshots:
+    def __init__(self, printer):
+        self.printer = printer
+        self.snapshots = {}
+    def get(self, name, po, eventtime):
+        get_status_version = getattr(po, 'get_status_version', None)
+        version = None
+        if get_status_version is not None:
+            version = get_status_version()
+        entry = self.snapshots.get(name)
+        if (entry is not None and version is not None
+            and entry[0] is po and entry[2] == version):
+            return entry[3]
+        with self.printer.get_reactor().assert_no_pause():
+            sts = po.get_status(eventtime)
+        if entry is not None and entry[0] is po and entry[1] is sts:
+            return entry[3]
+        res = freeze_status(sts)
+        self.snapshots[name] = (po, sts, version, res)
+        return res
+    def clear(self):
+        self.snapshots.clear()
+
+# Render time histogram buckets (in seconds)
+RENDER_BUCKETS = [.0001, .0003, .001, .003, .010, .030, .100]
+
+class RenderStats:
+    def __init__(self):
+        self.count = 0
+        self.total_time = self.max_time = 0.
+        self.buckets = [0] * (len(RENDER_BUCKETS) + 1)
+    def note(self, render_time):
+        self.count += 1
+        self.total_time += render_time
+        self.max_time = max(self.max_time, render_time)
+        for i, limit in enumerate(RENDER_BUCKETS):
+            if render_time < limit:
+                break
+        else:
+            i = len(RENDER_BUCKETS)
+        self.buckets[i] += 1
+
 # Wrapper around a Jinja2 template
 class TemplateWrapper:
     def __init__(self, printer, env, name, script):
@@ -50,8 +140,10 @@ class TemplateWrapper:
         self.gcode = self.printer.lookup_object('gcode')
         gcode_macro = self.printer.lookup_object('gcode_macro')
         self.create_template_context = gcode_macro.create_template_context
+        self.render_stats = gcode_macro.get_render_stats(name)
+        self.monotonic = printer.get_reactor().monotonic
         try:
-            self.template = env.from_string(script)
+            self.template = gcode_macro.compile_template(script)
         except jinja2.exceptions.TemplateSyntaxError as e:
             lines = script.splitlines()
             msg = "Error loading template '%s'\nline %s: %s # %s" % (
@@ -64,6 +156,7 @@ class TemplateWrapper:
             logging.exception(msg)
             raise printer.config_error(msg)
     def render(self, context=None):
+        start_time = self.monotonic()
         if context is None:
             context = self.create_template_context()
         try:
@@ -73,6 +166,8 @@ class TemplateWrapper:
                 self.name, traceback.format_exception_only(type(e), e)[-1])
             logging.exception(msg)
             raise self.gcode.error(msg)
+        finally:
+            self.render_stats.note(self.monotonic() - start_time)
     def run_gcode_from_command(self, context=None):
         self.gcode.run_script_from_command(self.render(context))
 
@@ -81,6 +176,24 @@ class PrinterGCodeMacro:
     def __init__(self, config):
         self.printer = config.get_printer()
         self.env = jinja2.Environment('{%', '%}', '{', '}')
+        self.templates = {}
+        self.render_stats = {}
+        self.status_snapshots = StatusSnapshots(self.printer)
+        gcode = self.printer.lookup_object('gcode')
+        gcode.register_command("MACRO_RENDER_STATS",
+                               self.cmd_MACRO_RENDER_STATS,
+                               desc=self.cmd_MACRO_RENDER_STATS_help)
+    def compile_template(self, script):
+        # Templates with identical source share the compiled template
+        template = self.templates.get(script)
+        if template is None:
+            template = self.templates[script] = self.env.from_string(script)
+        return template
+    def get_render_stats(self, name):
+        rs = self.render_stats.get(name)
+        if rs is None:
+            rs = self.render_stats[name] = RenderStats()
+        return rs
     def load_template(self, config, option, default=None):
         name = "%s:%s" % (config.get_name(), option)
         if default is None:
@@ -103,6 +216,28 @@ class PrinterGCodeMacro:
         except self.printer.command_error:
             logging.exception("Remote Call Error")
         return ""
+    cmd_MACRO_RENDER_STATS_help = "Report template render times"
+    def cmd_MACRO_RENDER_STATS(self, gcmd):
+        if gcmd.get_int('RESET', 0):
+            for rs in self.render_stats.values():
+                rs.__init__()
+            gcmd.respond_info("Template render statistics reset")
+            return
+        stats = sorted([(rs.total_time, name, rs)
+                        for name, rs in self.render_stats.items()
+                        if rs.count], reverse=True)
+        if not stats:
+            gcmd.respond_info("No templates have been rendered")
+            return
+        hdr = " ".join(["<%.1fms" % (b * 1000.,) for b in RENDER_BUCKETS])
+        lines = ["name: count total_ms avg_ms max_ms (%s >=%.1fms)"
+                 % (hdr, RENDER_BUCKETS[-1] * 1000.)]
+        for total_time, name, rs in stats:
+            lines.append("%s: %d %.3f %.3f %.3f (%s)" % (
+                name, rs.count, total_time * 1000.,
+                total_time * 1000. / rs.count, rs.max_time * 1000.,
+                " ".join([str(b) for b in rs.buckets])))
+        gcmd.respond_info("\n".join(lines))
     def create_template_context(self, eventtime=None):
         return {
             'printer': GetStatusWrapper(self.printer, eventtime),
@@ -150,6 +285,7 @@ class GCodeMacro:
                                         desc=self.cmd_SET_GCODE_VARIABLE_help)
         self.in_script = False
         self.variables = {}
+        self.status_version = 0
         prefix = 'variable_'
         for option in config.get_prefix_options(prefix):
             try:
@@ -171,6 +307,8 @@ class GCodeMacro:
         self.gcode.register_command(self.alias, self.cmd, desc=self.cmd_desc)
     def get_status(self, eventtime):
         return self.variables
+    def get_status_version(self):
+        return self.status_version
     cmd_SET_GCODE_VARIABLE_help = "Set the value of a G-Code macro variable"
     def cmd_SET_GCODE_VARIABLE(self, gcmd):
         variable = gcmd.get('VARIABLE')
@@ -186,6 +324,7 @@ class GCodeMacro:
         v = dict(self.variables)
         v[variable] = literal
         self.variables = v
+        self.status_version += 1
     def cmd(self, gcmd):
         if self.in_script:
             raise gcmd.error("Macro %s called recursively" % (self.alias,))
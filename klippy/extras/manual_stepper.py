@@ -133,6 +133,7 @@ class ManualStepper:
                 raise gcmd.error("Must unregister axis first")
             # Unregister
             toolhead.remove_extra_axis(self)
+            self.motion_queuing.set_trapq_accel_order(self.trapq, 2)
             self.axis_gcode_id = None
             return
         if (len(gcode_axis) != 1 or not gcode_axis.isupper()
@@ -149,18 +150,12 @@ class ManualStepper:
         self.gaxis_limit_velocity = limit_velocity
         self.gaxis_limit_accel = limit_accel
         toolhead.add_extra_axis(self, self.commanded_pos)
-    def process_move(self, print_time, move, ea_index):
-        axis_r = move.axes_r[ea_index]
-        start_pos = move.start_pos[ea_index]
-        accel = move.accel * axis_r
-        start_v = move.start_v * axis_r
-        cruise_v = move.cruise_v * axis_r
-        self.trapq_append(self.trapq, print_time,
-                          move.accel_t, move.cruise_t, move.decel_t,
-                          start_pos, 0., 0.,
-                          1., 0., 0.,
-                          start_v, cruise_v, accel)
-        self.commanded_pos = move.end_pos[ea_index]
+        self.motion_queuing.set_trapq_accel_order(self.trapq,
+                                                  toolhead.get_accel_order())
+    def process_moves(self, batch, ea_index):
+        end_pos = batch.append_axis(self.trapq, ea_index)
+        if end_pos is not None:
+            self.commanded_pos = end_pos
     def check_move(self, move, ea_index):
         # Check move is in bounds
         movepos = move.end_pos[ea_index]
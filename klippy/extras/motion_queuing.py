@@ -20,6 +20,19 @@ SDS_CHECK_TIME = 0.001 # step+dir+step filter in stepcompress.c
 DRIP_SEGMENT_TIME = 0.050
 DRIP_TIME = 0.100
 
+# Adaptive flush timing (scale factor applied to the BGFLUSH_* times)
+ADAPT_MIN_SCALE = 0.5
+ADAPT_MAX_SCALE = 3.0
+ADAPT_GROW = 1.25
+ADAPT_SHRINK = 0.95
+ADAPT_LOW_MARGIN = 0.100
+ADAPT_LOW_BUFFER = 0.500
+ADAPT_HIGH_GEN_RATIO = 0.20
+ADAPT_LOW_GEN_RATIO = 0.05
+ADAPT_HIGH_QUEUE_RATIO = 0.80
+ADAPT_LOW_QUEUE_RATIO = 0.50
+ADAPT_SERIAL_BACKLOG = 4096
+
 class PrinterMotionQueuing:
     def __init__(self, config):
         self.printer = printer = config.get_printer()
@@ -34,6 +47,7 @@ class PrinterMotionQueuing:
         self.syncemitters = []
         self.steppersyncs = []
         self.steppersyncmgr_gen_steps = ffi_lib.steppersyncmgr_gen_steps
+        self.movequeues = []
         # History expiration
         self.clear_history_time = 0.
         # Flush notification callbacks
@@ -54,6 +68,20 @@ class PrinterMotionQueuing:
         self.do_kick_flush_timer = True
         self.last_flush_time = self.last_step_gen_time = 0.
         self.need_flush_time = self.need_step_gen_time = 0.
+        # Adaptive flush timing
+        self.adapt_enabled = False
+        self.flush_scale = 1.
+        self.bgflush_low_time = BGFLUSH_LOW_TIME
+        self.bgflush_high_time = BGFLUSH_HIGH_TIME
+        self.bgflush_sg_low_time = BGFLUSH_SG_LOW_TIME
+        self.bgflush_sg_high_time = BGFLUSH_SG_HIGH_TIME
+        self.gen_wall_time = self.gen_print_time = 0.
+        self.min_sg_margin = None
+        self.last_stats_time = self.last_stats_need_time = 0.
+        self.adapt_status = {
+            'adaptive_flush': False, 'flush_scale': 1., 'step_gen_ratio': 0.,
+            'step_gen_margin': 0., 'movequeue_ratio': 0., 'serial_backlog': 0,
+            'input_rate': 0.}
         # "Drip" timing (for homing and probing moves)
         self.drip_start_times = []
         # Register handlers
@@ -67,6 +95,9 @@ class PrinterMotionQueuing:
     def wipe_trapq(self, trapq):
         # Expire any remaining movement in the trapq (force to history list)
         self.trapq_finalize_moves(trapq, self.reactor.NEVER, 0.)
+    def set_trapq_accel_order(self, trapq, accel_order):
+        ffi_main, ffi_lib = chelper.get_ffi()
+        ffi_lib.trapq_set_accel_order(trapq, accel_order)
     def lookup_trapq_append(self):
         ffi_main, ffi_lib = chelper.get_ffi()
         return ffi_lib.trapq_append
@@ -91,6 +122,7 @@ class PrinterMotionQueuing:
         ffi_main, ffi_lib = chelper.get_ffi()
         ss = self._lookup_steppersync(mcu)
         ffi_lib.steppersync_setup_movequeue(ss, serialqueue, move_count)
+        self.movequeues.append((mcu, ss, serialqueue))
         mcu_freq = float(mcu.seconds_to_clock(1.))
         ffi_lib.steppersync_set_time(ss, 0., mcu_freq)
     def stats(self, eventtime):
@@ -103,7 +135,27 @@ class PrinterMotionQueuing:
         # Calculate history expiration
         est_print_time = self.mcu.estimated_print_time(eventtime)
         self.clear_history_time = max(0., est_print_time - MOVE_HISTORY_EXPIRE)
+        # Update adaptive flush timing
+        self._update_flush_scale(eventtime, est_print_time)
         return False, ""
+    def get_status(self, eventtime):
+        return self.adapt_status
+    def movequeue_stats(self, mcu, eventtime):
+        # Report mcu move queue occupancy, time until the mcu runs out
+        # of queued moves, and commands delayed by a full mcu queue
+        ffi_main, ffi_lib = chelper.get_ffi()
+        for mq_mcu, ss, serialqueue in self.movequeues:
+            if mq_mcu is not mcu:
+                continue
+            est_print_time = mcu.estimated_print_time(eventtime)
+            stats = ffi_main.new('struct steppersync_stats *')
+            ffi_lib.steppersync_get_stats(ss, est_print_time, stats)
+            return ("movequeue_used=%d movequeue_size=%d"
+                    " movequeue_starve_time=%.3f movequeue_moves=%d"
+                    " movequeue_stalls=%d movequeue_stall_time=%.3f" % (
+                        stats.queue_used, stats.move_count, stats.starve_time,
+                        stats.move_msgs, stats.stall_count, stats.stall_time))
+        return ""
     # Flush notification callbacks
     def register_flush_callback(self, callback, can_add_trapq=False):
         if can_add_trapq:
@@ -150,10 +202,13 @@ class PrinterMotionQueuing:
         if not self.can_pause:
             clear_history_time = max(0., trapq_free_time - MOVE_HISTORY_EXPIRE)
         # Generate stepper movement and transmit
+        gen_start_time = self.reactor.monotonic()
         ret = self.steppersyncmgr_gen_steps(self.steppersyncmgr, flush_time,
                                             step_gen_time, clear_history_time)
         if ret:
             raise self.mcu.error("Internal error in stepcompress")
+        self.gen_wall_time += self.reactor.monotonic() - gen_start_time
+        self.gen_print_time += step_gen_time - self.last_step_gen_time
         self.last_flush_time = flush_time
         self.last_step_gen_time = step_gen_time
         # Move processed trapq entries to history list, and expire old history
@@ -166,7 +221,7 @@ class PrinterMotionQueuing:
                 return
             systime = self.reactor.monotonic()
             est_print_time = self.mcu.estimated_print_time(systime)
-            wait = want_flush_time - BGFLUSH_HIGH_TIME - est_print_time
+            wait = want_flush_time - self.bgflush_high_time - est_print_time
             if wait <= 0.:
                 return
             self.reactor.pause(systime + min(1., wait))
@@ -183,8 +238,12 @@ class PrinterMotionQueuing:
             aggr_sg_time = self.need_step_gen_time - 2.*self.kin_flush_delay
             if self.last_step_gen_time < aggr_sg_time:
                 # Actively stepping - want more aggressive flushing
-                want_sg_time = est_print_time + BGFLUSH_SG_HIGH_TIME
-                batch_time = BGFLUSH_SG_HIGH_TIME - BGFLUSH_SG_LOW_TIME
+                sg_margin = self.last_step_gen_time - est_print_time
+                if self.min_sg_margin is None or sg_margin < self.min_sg_margin:
+                    self.min_sg_margin = sg_margin
+                want_sg_time = est_print_time + self.bgflush_sg_high_time
+                batch_time = (self.bgflush_sg_high_time
+                              - self.bgflush_sg_low_time)
                 next_batch_time = self.last_step_gen_time + batch_time
                 if next_batch_time > est_print_time:
                     # Improve run-to-run reproducibility by batching from last
@@ -198,7 +257,7 @@ class PrinterMotionQueuing:
                     self._advance_flush_time(0., want_sg_time)
             else:
                 # Not stepping (or only step remnants) - use relaxed flushing
-                want_flush_time = est_print_time + BGFLUSH_HIGH_TIME
+                want_flush_time = est_print_time + self.bgflush_high_time
                 max_flush_time = self.need_flush_time + BGFLUSH_EXTRA_TIME
                 want_flush_time = min(want_flush_time, max_flush_time)
                 # Flush motion queues (if needed)
@@ -207,13 +266,13 @@ class PrinterMotionQueuing:
             # Reschedule timer
             aggr_sg_time = self.need_step_gen_time - 2.*self.kin_flush_delay
             if self.last_step_gen_time < aggr_sg_time:
-                waketime = self.last_step_gen_time - BGFLUSH_SG_LOW_TIME
+                waketime = self.last_step_gen_time - self.bgflush_sg_low_time
             else:
                 self.do_kick_flush_timer = True
                 max_flush_time = self.need_flush_time + BGFLUSH_EXTRA_TIME
                 if self.last_flush_time >= max_flush_time:
                     return self.reactor.NEVER
-                waketime = self.last_flush_time - BGFLUSH_LOW_TIME
+                waketime = self.last_flush_time - self.bgflush_low_time
             return eventtime + waketime - est_print_time
         except:
             logging.exception("Exception in flush_handler")
@@ -248,6 +307,74 @@ class PrinterMotionQueuing:
         if self.do_kick_flush_timer:
             self.do_kick_flush_timer = False
             self.reactor.update_timer(self.flush_timer, self.reactor.NOW)
+    # Adaptive flush timing
+    def enable_adaptive_flush(self):
+        if self.can_pause:
+            self.adapt_enabled = True
+    def get_flush_scale(self):
+        return self.flush_scale
+    def _set_flush_scale(self, scale):
+        self.flush_scale = scale
+        self.bgflush_low_time = BGFLUSH_LOW_TIME * scale
+        self.bgflush_high_time = BGFLUSH_HIGH_TIME * scale
+        self.bgflush_sg_low_time = BGFLUSH_SG_LOW_TIME * scale
+        self.bgflush_sg_high_time = BGFLUSH_SG_HIGH_TIME * scale
+        self.printer.send_event("motion_queuing:flush_scale", scale)
+    def _update_flush_scale(self, eventtime, est_print_time):
+        # Step generation cost (host time per second of generated motion)
+        gen_ratio = 0.
+        if self.gen_print_time > 0.:
+            gen_ratio = self.gen_wall_time / self.gen_print_time
+        self.gen_wall_time = self.gen_print_time = 0.
+        # Smallest amount of buffered steps seen while actively stepping
+        sg_margin = self.min_sg_margin
+        self.min_sg_margin = None
+        # G-Code input rate (seconds of motion queued per second)
+        input_rate = 0.
+        stats_time = eventtime - self.last_stats_time
+        if stats_time > 0.:
+            input_rate = max(0., (self.need_flush_time
+                                  - self.last_stats_need_time) / stats_time)
+        self.last_stats_time = eventtime
+        self.last_stats_need_time = self.need_flush_time
+        # Mcu move queue occupancy and serial transmit backlog
+        ffi_main, ffi_lib = chelper.get_ffi()
+        queue_ratio = 0.
+        serial_backlog = 0
+        stats = ffi_main.new('struct steppersync_stats *')
+        for mcu, ss, serialqueue in self.movequeues:
+            ffi_lib.steppersync_get_stats(ss, est_print_time, stats)
+            queue_ratio = max(queue_ratio,
+                              stats.queue_used / float(stats.move_count or 1))
+            serial_backlog = max(serial_backlog,
+                                 ffi_lib.serialqueue_get_ready_bytes(
+                                     serialqueue))
+        self.adapt_status = {
+            'adaptive_flush': self.adapt_enabled,
+            'flush_scale': self.flush_scale, 'step_gen_ratio': gen_ratio,
+            'step_gen_margin': max(0., sg_margin or 0.),
+            'movequeue_ratio': queue_ratio, 'serial_backlog': serial_backlog,
+            'input_rate': input_rate}
+        if not self.adapt_enabled or not self.can_pause:
+            return
+        # Grow flush windows quickly when under pressure, shrink slowly
+        is_stepping = sg_margin is not None
+        buffer_time = self.need_flush_time - est_print_time
+        is_starved = (is_stepping and input_rate < 1.
+                      and buffer_time < ADAPT_LOW_BUFFER * self.flush_scale)
+        scale = self.flush_scale
+        if (gen_ratio > ADAPT_HIGH_GEN_RATIO
+            or queue_ratio > ADAPT_HIGH_QUEUE_RATIO
+            or serial_backlog > ADAPT_SERIAL_BACKLOG
+            or (is_stepping and sg_margin < ADAPT_LOW_MARGIN) or is_starved):
+            scale = min(ADAPT_MAX_SCALE, scale * ADAPT_GROW)
+        elif (gen_ratio < ADAPT_LOW_GEN_RATIO
+              and queue_ratio < ADAPT_LOW_QUEUE_RATIO
+              and (not is_stepping or sg_margin >= 2. * ADAPT_LOW_MARGIN)):
+            scale = max(ADAPT_MIN_SCALE, scale * ADAPT_SHRINK)
+        if scale != self.flush_scale:
+            self._set_flush_scale(scale)
+            self.adapt_status['flush_scale'] = scale
     # "Drip" timing (for homing and probing moves)
     def drip_update_time(self, start_time, end_time, drip_completion):
         self.drip_start_times.append(start_time)
@@ -68,6 +68,7 @@ class DumpStepper:
                 "last_clock": last_clock, "last_step_time": last_time}
 
 NEVER_TIME = 9999999999999999.
+SNAPSHOT_MOVES = 1024
 
 # Extract trapezoidal motion queue (trapq)
 class DumpTrapQ:
@@ -75,6 +76,8 @@ class DumpTrapQ:
         self.printer = printer
         self.name = name
         self.trapq = trapq
+        ffi_main, ffi_lib = chelper.get_ffi()
+        ffi_lib.trapq_enable_snapshot(trapq, SNAPSHOT_MOVES)
         self.last_batch_msg = (0., 0.)
         self.motion_queuing = printer.lookup_object("motion_queuing")
         self.batch_bulk = bulk_sensor.BatchBulkHelper(printer,
@@ -109,18 +112,12 @@ class DumpTrapQ:
                           m.start_x, m.start_y, m.start_z, m.x_r, m.y_r, m.z_r))
         logging.info('\n'.join(out))
     def get_trapq_position(self, print_time):
+        # Note, this may be called from any thread
         ffi_main, ffi_lib = chelper.get_ffi()
-        data = ffi_main.new('struct pull_move[1]')
-        count = ffi_lib.trapq_extract_old(self.trapq, data, 1, 0., print_time)
-        if not count:
+        data = ffi_main.new('struct pull_position *')
+        if not ffi_lib.trapq_snapshot_position(self.trapq, print_time, data):
             return None, None
-        move = data[0]
-        move_time = max(0., min(move.move_t, print_time - move.print_time))
-        dist = (move.start_v + .5 * move.accel * move_time) * move_time;
-        pos = (move.start_x + move.x_r * dist, move.start_y + move.y_r * dist,
-               move.start_z + move.z_r * dist)
-        velocity = move.start_v + move.accel * move_time
-        return pos, velocity
+        return (data.x, data.y, data.z), data.velocity
     def _process_batch(self, eventtime):
         qtime = self.last_batch_msg[0] + min(self.last_batch_msg[1], 0.100)
         data, cdata = self.extract_trapq(qtime, NEVER_TIME)
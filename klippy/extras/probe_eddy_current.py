@@ -4,7 +4,7 @@
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
 import logging, math, bisect
-import mcu
+import mcu, workerpool
 from . import ldc1612, probe, manual_probe
 
 OUT_OF_RANGE = 99.9
@@ -166,7 +166,8 @@ class EddyCalibration:
         # Perform calibration movement and capture
         cal = self.do_calibration_moves(self.probe_speed)
         # Calculate each sample position average and variance
-        positions, std, total = self.calc_freqs(cal)
+        pool = workerpool.get_worker_pool(self.printer)
+        positions, std, total = pool.run(self.calc_freqs, (cal,))
         last_freq = 0.
         for pos, freq in reversed(sorted(positions.items())):
             if freq <= last_freq:
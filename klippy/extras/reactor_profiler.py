@@ -0,0 +1,73 @@
+# Report the time spent in each reactor callback
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import reactor
+
+class PrinterReactorProfiler:
+    def __init__(self, config):
+        self.printer = config.get_printer()
+        self.report_count = config.getint('report_count', 3, minval=0)
+        self.profiler = self.printer.get_reactor().setup_profiler()
+        self.last_totals = {}
+        # Register webhooks endpoint and g-code command
+        wh = self.printer.lookup_object('webhooks')
+        wh.register_endpoint("reactor/profile", self._handle_profile)
+        gcode = self.printer.lookup_object('gcode')
+        gcode.register_command("REACTOR_PROFILE", self.cmd_REACTOR_PROFILE,
+                               desc=self.cmd_REACTOR_PROFILE_help)
+    def _get_top(self, count):
+        entries = sorted(self.profiler.get_stats(),
+                         key=(lambda s: s.total_time), reverse=True)
+        return entries[:count]
+    def _reset(self):
+        self.profiler.reset()
+        self.last_totals.clear()
+    def _handle_profile(self, web_request):
+        count = web_request.get_int('count', 20)
+        entries = [s.get_status() for s in self._get_top(count)]
+        if web_request.get('reset', False, types=(bool,)):
+            self._reset()
+        web_request.send({'buckets': reactor.PROFILE_BUCKETS,
+                          'entries': entries})
+    cmd_REACTOR_PROFILE_help = "Report the time spent in reactor callbacks"
+    def cmd_REACTOR_PROFILE(self, gcmd):
+        if gcmd.get_int('RESET', 0):
+            self._reset()
+            gcmd.respond_info("Reactor profile statistics reset")
+            return
+        count = gcmd.get_int('COUNT', 10, minval=1)
+        stats = [s for s in self._get_top(count) if s.count]
+        if not stats:
+            gcmd.respond_info("No reactor callbacks have been profiled")
+            return
+        buckets = reactor.PROFILE_BUCKETS
+        hdr = " ".join(["<%gms" % (b * 1000.,) for b in buckets])
+        lines = ["type name: count total_ms avg_ms max_ms max_late_ms"
+                 " (%s >=%gms)" % (hdr, buckets[-1] * 1000.)]
+        for s in stats:
+            lines.append("%s %s: %d %.3f %.3f %.3f %.3f (%s)" % (
+                s.kind, s.name, s.count, s.total_time * 1000.,
+                s.total_time * 1000. / s.count, s.max_time * 1000.,
+                s.max_lateness * 1000.,
+                " ".join([str(b) for b in s.time_buckets])))
+        gcmd.respond_info("\n".join(lines))
+    def stats(self, eventtime):
+        # Report the callbacks that used the most time since the last report
+        busy = 0.
+        diffs = []
+        last_totals = self.last_totals
+        for s in self.profiler.get_stats():
+            diff = s.total_time - last_totals.get(s, 0.)
+            if diff > 0.:
+                last_totals[s] = s.total_time
+                busy += diff
+                diffs.append((diff, s.name))
+        diffs.sort(reverse=True)
+        top = ",".join(["%s:%.3f" % (name, diff)
+                        for diff, name in diffs[:self.report_count]])
+        return False, "reactor_busy=%.3f reactor_top=%s" % (busy, top)
+
+def load_config(config):
+    return PrinterReactorProfiler(config)
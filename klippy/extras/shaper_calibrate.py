@@ -3,7 +3,7 @@
 # Copyright (C) 2020-2024  Dmitry Butyugin <dmbutyugin@google.com>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
-import collections, importlib, logging, math, multiprocessing, traceback
+import collections, importlib, logging, math
 shaper_defs = importlib.import_module('.shaper_defs', 'extras')
 
 MIN_FREQ = 5.
@@ -71,41 +71,33 @@ class ShaperCalibrate:
                     "installed via `~/klippy-env/bin/pip install` (refer to "
                     "docs/Measuring_Resonances.md for more details).")
 
+    def _background_wait(self, pool, completion):
+        try:
+            return pool.wait(completion, "Wait for calculations..")
+        except self.error:
+            raise
+        except Exception as e:
+            raise self.error("Error in remote calculation: %s" % (e,))
+
     def background_process_exec(self, method, args):
         if self.printer is None:
             return method(*args)
-        import queuelogger
-        parent_conn, child_conn = multiprocessing.Pipe()
-        def wrapper():
-            queuelogger.clear_bg_logging()
-            try:
-                res = method(*args)
-            except:
-                child_conn.send((True, traceback.format_exc()))
-                child_conn.close()
-                return
-            child_conn.send((False, res))
-            child_conn.close()
-        # Start a process to perform the calculation
-        calc_proc = multiprocessing.Process(target=wrapper)
-        calc_proc.daemon = True
-        calc_proc.start()
-        # Wait for the process to finish
-        reactor = self.printer.get_reactor()
-        gcode = self.printer.lookup_object("gcode")
-        eventtime = last_report_time = reactor.monotonic()
-        while calc_proc.is_alive():
-            if eventtime > last_report_time + 5.:
-                last_report_time = eventtime
-                gcode.respond_info("Wait for calculations..", log=False)
-            eventtime = reactor.pause(eventtime + .1)
-        # Return results
-        is_err, res = parent_conn.recv()
-        if is_err:
-            raise self.error("Error in remote calculation: %s" % (res,))
-        calc_proc.join()
-        parent_conn.close()
-        return res
+        import workerpool
+        pool = workerpool.get_worker_pool(self.printer)
+        return self._background_wait(pool, pool.submit(method, args))
+
+    def background_process_map(self, method, args_list):
+        # Run several calculations in parallel (results are returned
+        # in order as they become available)
+        if self.printer is None:
+            for args in args_list:
+                yield method(*args)
+            return
+        import workerpool
+        pool = workerpool.get_worker_pool(self.printer)
+        completions = [pool.submit(method, args) for args in args_list]
+        for completion in completions:
+            yield self._background_wait(pool, completion)
 
     def _split_into_windows(self, x, window_size, overlap):
         # Memory-efficient algorithm to split an input 'x' into a series
@@ -326,12 +318,11 @@ class ShaperCalibrate:
         best_shaper = None
         all_shapers = []
         shapers = shapers or AUTOTUNE_SHAPERS
-        for shaper_cfg in shaper_defs.INPUT_SHAPERS:
-            if shaper_cfg.name not in shapers:
-                continue
-            shaper = self.background_process_exec(self.fit_shaper, (
-                shaper_cfg, calibration_data, shaper_freqs, damping_ratio,
-                scv, max_smoothing, test_damping_ratios, max_freq))
+        fit_args = [(shaper_cfg, calibration_data, shaper_freqs, damping_ratio,
+                     scv, max_smoothing, test_damping_ratios, max_freq)
+                    for shaper_cfg in shaper_defs.INPUT_SHAPERS
+                    if shaper_cfg.name in shapers]
+        for shaper in self.background_process_map(self.fit_shaper, fit_args):
             if logger is not None:
                 logger("Fitted shaper '%s' frequency = %.1f Hz "
                        "(vibrations = %.1f%%, smoothing ~= %.3f)" % (
@@ -3,6 +3,7 @@
 # Copyright (C) 2025 Gareth Farrington <gareth@waves.ky>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
+import math
 
 MAX_INT32 = (2 ** 31)
 MIN_INT32 = -(2 ** 31) - 1
@@ -20,6 +21,24 @@ def to_fixed_32(value, int_bits):
                            % (int_bits,))
 
 
+# Design a Butterworth lowpass filter as SciPy formatted SOS sections
+# (equivalent to scipy.signal.butter(order, cutoff, fs=sps,
+# output='sos') for even orders, but without requiring SciPy)
+def butter_lowpass_sections(cutoff, sps, order=4):
+    if order < 2 or order % 2:
+        raise ValueError("Lowpass filter order must be an even number")
+    w0 = 2. * math.pi * cutoff / sps
+    cos_w0 = math.cos(w0)
+    sections = []
+    for k in range(order // 2):
+        q = 1. / (2. * math.cos((2 * k + 1) * math.pi / (2. * order)))
+        alpha = math.sin(w0) / (2. * q)
+        a0 = 1. + alpha
+        b0 = (1. - cos_w0) / (2. * a0)
+        sections.append([b0, 2. * b0, b0,
+                         1., -2. * cos_w0 / a0, (1. - alpha) / a0])
+    return sections
+
 # Digital filter designer and container
 class DigitalFilter:
     def __init__(self, sps, cfg_error, highpass=None, highpass_order=1,
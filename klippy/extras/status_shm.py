@@ -0,0 +1,182 @@
+# Export printer status to a shared memory file
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import os, mmap, struct, logging
+import chelper
+
+# File layout (all values are little endian) - see docs/API_Server.md
+SHM_MAGIC = b"KLIPSHM\0"
+SHM_VERSION = 1
+# magic, version, file size, sequence, heater count, mcu count,
+# names offset, data offset, reserved
+HEADER_FORMAT = "<8s8I"
+SEQUENCE_OFFSET = 16
+NAME_SIZE = 32
+# update_time, live_position (x, y, z, e), live_velocity,
+# live_extruder_velocity, print_duration, total_duration, filament_used,
+# progress, printer_state, print_state, current_layer, total_layer
+STATUS_FORMAT = "<11d2I2i"
+PRINTER_STATE_OFFSET = 88
+# temperature, target, power
+HEATER_FORMAT = "<3d"
+# mcu_awake, mcu_task_avg, mcu_task_stddev, srtt, rto, freq,
+# bytes_write, bytes_read, bytes_retransmit, bytes_invalid
+MCU_FORMAT = "<6d4Q"
+STATUS_SIZE = struct.calcsize(STATUS_FORMAT)
+HEATER_SIZE = struct.calcsize(HEATER_FORMAT)
+MCU_SIZE = struct.calcsize(MCU_FORMAT)
+MCU_FLOAT_STATS = ['mcu_awake', 'mcu_task_avg', 'mcu_task_stddev',
+                   'srtt', 'rto', 'freq']
+MCU_INT_STATS = ['bytes_write', 'bytes_read', 'bytes_retransmit',
+                 'bytes_invalid']
+
+PRINTER_STATES = ['startup', 'ready', 'shutdown', 'error', 'disconnected']
+PRINT_STATES = ['standby', 'printing', 'paused', 'complete', 'cancelled',
+                'error']
+
+class PrinterStatusShm:
+    def __init__(self, config):
+        self.printer = config.get_printer()
+        self.reactor = self.printer.get_reactor()
+        self.path = config.get('path')
+        self.update_interval = config.getfloat('update_interval', .100,
+                                               minval=.010)
+        self.ffi_main, self.ffi_lib = chelper.get_ffi()
+        self.shm = self.update_timer = None
+        self.heaters = []
+        self.mcus = []
+        self.motion_report = self.print_stats = self.virtual_sdcard = None
+        self.status_buf = self.status_ptr = None
+        self.seq_ptr = self.data_ptr = self.shm_ptr = None
+        self.printer.register_event_handler("klippy:connect",
+                                            self._handle_connect)
+        self.printer.register_event_handler("klippy:ready", self._handle_ready)
+        self.printer.register_event_handler("klippy:disconnect",
+                                            self._handle_disconnect)
+    def _create_file(self):
+        # Build the header and names
+        names = [n for n, h in self.heaters] + [n for n, m in self.mcus]
+        names_offset = struct.calcsize(HEADER_FORMAT)
+        data_offset = names_offset + len(names) * NAME_SIZE
+        data_size = (STATUS_SIZE + len(self.heaters) * HEATER_SIZE
+                     + len(self.mcus) * MCU_SIZE)
+        size = data_offset + data_size
+        data = bytearray(size)
+        struct.pack_into(HEADER_FORMAT, data, 0, SHM_MAGIC, SHM_VERSION,
+                         size, 0, len(self.heaters), len(self.mcus),
+                         names_offset, data_offset, 0)
+        for i, name in enumerate(names):
+            ename = name.encode()[:NAME_SIZE-1]
+            offset = names_offset + i * NAME_SIZE
+            data[offset:offset+len(ename)] = ename
+        # Write to a temporary file and rename it so that readers never
+        # observe a partially initialized file
+        tmppath = "%s.%d.tmp" % (self.path, os.getpid())
+        fd = os.open(tmppath, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o644)
+        try:
+            os.write(fd, bytes(data))
+            shm = mmap.mmap(fd, size)
+            os.rename(tmppath, self.path)
+        finally:
+            os.close(fd)
+        self.shm = shm
+        ffi_main = self.ffi_main
+        self.shm_ptr = ffi_main.from_buffer(shm)
+        self.seq_ptr = ffi_main.cast('uint32_t *',
+                                     self.shm_ptr + SEQUENCE_OFFSET)
+        self.data_ptr = self.shm_ptr + data_offset
+        self.status_buf = bytearray(data_size)
+        self.status_ptr = ffi_main.from_buffer(self.status_buf)
+    def _handle_connect(self):
+        # Lookup the objects to export
+        pheaters = self.printer.lookup_object('heaters', None)
+        if pheaters is not None:
+            self.heaters = [(name, pheaters.lookup_heater(name.split()[-1]))
+                            for name in pheaters.get_all_heaters()]
+        self.mcus = [(name.split()[-1], mcu)
+                     for name, mcu in self.printer.lookup_objects('mcu')]
+        self.motion_report = self.printer.lookup_object('motion_report', None)
+        self.print_stats = self.printer.lookup_object('print_stats', None)
+        self.virtual_sdcard = self.printer.lookup_object('virtual_sdcard',
+                                                         None)
+        try:
+            self._create_file()
+        except (OSError, IOError) as e:
+            logging.exception("Unable to create status shared memory file")
+            raise self.printer.config_error(
+                "Unable to create status file '%s': %s" % (self.path, e))
+    def _handle_ready(self):
+        self.update_timer = self.reactor.register_timer(self._update_event,
+                                                        self.reactor.NOW)
+    def _handle_disconnect(self):
+        if self.shm is None:
+            return
+        if self.update_timer is not None:
+            self.reactor.unregister_timer(self.update_timer)
+            self.update_timer = None
+        # Notify readers that the file is no longer updated
+        struct.pack_into("<I", self.status_buf, PRINTER_STATE_OFFSET,
+                         PRINTER_STATES.index('disconnected'))
+        self._publish()
+        self.ffi_main.release(self.shm_ptr)
+        self.seq_ptr = self.data_ptr = self.shm_ptr = None
+        self.shm.close()
+        self.shm = None
+    def _write_status(self, eventtime, printer_state):
+        buf = self.status_buf
+        pos = [0., 0., 0., 0.]
+        velocity = evelocity = 0.
+        if self.motion_report is not None:
+            mstatus = self.motion_report.get_status(eventtime)
+            pos = mstatus['live_position']
+            velocity = mstatus['live_velocity']
+            evelocity = mstatus['live_extruder_velocity']
+        print_duration = total_duration = filament_used = 0.
+        print_state = current_layer = total_layer = 0
+        if self.print_stats is not None:
+            pstatus = self.print_stats.get_status(eventtime)
+            print_duration = pstatus['print_duration']
+            total_duration = pstatus['total_duration']
+            filament_used = pstatus['filament_used']
+            if pstatus['state'] in PRINT_STATES:
+                print_state = PRINT_STATES.index(pstatus['state'])
+            info = pstatus['info']
+            current_layer = info['current_layer']
+            total_layer = info['total_layer']
+        progress = 0.
+        if self.virtual_sdcard is not None:
+            progress = self.virtual_sdcard.progress()
+        struct.pack_into(
+            STATUS_FORMAT, buf, 0, eventtime, pos[0], pos[1], pos[2], pos[3],
+            velocity, evelocity, print_duration, total_duration,
+            filament_used, progress, PRINTER_STATES.index(printer_state),
+            print_state, -1 if current_layer is None else current_layer,
+            -1 if total_layer is None else total_layer)
+        offset = STATUS_SIZE
+        for name, heater in self.heaters:
+            hstatus = heater.get_status(eventtime)
+            struct.pack_into(HEATER_FORMAT, buf, offset,
+                             hstatus['temperature'], hstatus['target'],
+                             hstatus['power'])
+            offset += HEATER_SIZE
+        for name, mcu in self.mcus:
+            stats = mcu.get_status(eventtime).get('last_stats', {})
+            struct.pack_into(MCU_FORMAT, buf, offset,
+                             *([float(stats.get(s, 0.))
+                                for s in MCU_FLOAT_STATS]
+                               + [int(stats.get(s, 0))
+                                  for s in MCU_INT_STATS]))
+            offset += MCU_SIZE
+        self._publish()
+    def _publish(self):
+        self.ffi_lib.seqlock_write(self.seq_ptr, self.data_ptr,
+                                   self.status_ptr, len(self.status_buf))
+    def _update_event(self, eventtime):
+        printer_state = self.printer.get_state_message()[1]
+        self._write_status(eventtime, printer_state)
+        return eventtime + self.update_interval
+
+def load_config(config):
+    return PrinterStatusShm(config)
@@ -0,0 +1,53 @@
+# Support for stepping several steppers from a single mcu timer
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+
+class StepperGroup:
+    def __init__(self, config):
+        self.printer = config.get_printer()
+        self.name = config.get_name()
+        self.stepper_names = config.getlist('steppers')
+        if len(self.stepper_names) < 2:
+            raise config.error("Option 'steppers' in section '%s' must"
+                               " specify at least two steppers" % (self.name,))
+        self.tolerance = config.getfloat('tolerance', 0.000001,
+                                         minval=0., maxval=0.000010)
+        self.mcu = self.oid = None
+        self.steppers = []
+        self.printer.load_object(config, 'force_move')
+        self.printer.register_event_handler("klippy:mcu_identify",
+                                            self._handle_mcu_identify)
+    def _handle_mcu_identify(self):
+        force_move = self.printer.lookup_object('force_move')
+        for sname in self.stepper_names:
+            stepper = force_move.lookup_stepper(sname)
+            if stepper in self.steppers:
+                raise self.printer.config_error(
+                    "Stepper %s specified twice in '%s'" % (sname, self.name))
+            self.steppers.append(stepper)
+        self.mcu = self.steppers[0].get_mcu()
+        for stepper in self.steppers:
+            if stepper.get_mcu() is not self.mcu:
+                raise self.printer.config_error(
+                    "All steppers in '%s' must be on the same mcu"
+                    % (self.name,))
+        if self.mcu.try_lookup_command(
+                "stepper_group_add oid=%c stepper_oid=%c") is None:
+            raise self.printer.config_error(
+                "MCU '%s' does not support stepper groups"
+                % (self.mcu.get_name(),))
+        self.oid = self.mcu.create_oid()
+        self.mcu.register_config_callback(self._build_config)
+    def _build_config(self):
+        tolerance_ticks = self.mcu.seconds_to_clock(self.tolerance)
+        self.mcu.add_config_cmd(
+            "config_stepper_group oid=%d stepper_count=%d tolerance_ticks=%d"
+            % (self.oid, len(self.steppers), tolerance_ticks))
+        for stepper in self.steppers:
+            self.mcu.add_config_cmd("stepper_group_add oid=%d stepper_oid=%d"
+                                    % (self.oid, stepper.get_oid()))
+
+def load_config_prefix(config):
+    return StepperGroup(config)
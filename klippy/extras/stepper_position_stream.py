@@ -0,0 +1,154 @@
+# Stream stepper positions sampled by the micro-controller
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import logging
+from . import bulk_sensor
+
+MIN_MSG_TIME = 0.100
+BYTES_PER_POSITION = 4
+MESSAGE_DATA_SIZE = 51
+POSITION_ERROR = -0x80000000
+SAMPLE_PERIOD = 0.001
+BATCH_UPDATES = 0.100
+
+class StepperPositionStream:
+    def __init__(self, config):
+        self.printer = config.get_printer()
+        self.name = config.get_name().split()[-1]
+        self.stepper_names = config.getlist('steppers')
+        max_steppers = MESSAGE_DATA_SIZE // BYTES_PER_POSITION
+        if len(self.stepper_names) > max_steppers:
+            raise config.error("Option 'steppers' in section '%s' may not"
+                               " specify more than %d steppers"
+                               % (config.get_name(), max_steppers))
+        self.sample_period = config.getfloat('sample_period', SAMPLE_PERIOD,
+                                             above=0.)
+        self.samples_per_block = (MESSAGE_DATA_SIZE
+                                  // (BYTES_PER_POSITION
+                                      * len(self.stepper_names)))
+        self.mcu = self.oid = self.query_cmd = self.bulk_queue = None
+        self.steppers = []
+        # Measurement conversion
+        self.start_clock = self.sample_ticks = 0
+        self.last_sequence = 0
+        # Process messages in batches
+        self.batch_bulk = bulk_sensor.BatchBulkHelper(
+            self.printer, self._process_batch,
+            self._start_measurements, self._finish_measurements, BATCH_UPDATES)
+        hdr = ['time']
+        for sname in self.stepper_names:
+            hdr.extend([sname, sname + '_commanded'])
+        self.batch_bulk.add_mux_endpoint("stepper_position/dump_positions",
+                                         "stream", self.name,
+                                         {'header': tuple(hdr)})
+        self.printer.load_object(config, 'force_move')
+        self.printer.register_event_handler("klippy:mcu_identify",
+                                            self._handle_mcu_identify)
+    def _handle_mcu_identify(self):
+        force_move = self.printer.lookup_object('force_move')
+        for sname in self.stepper_names:
+            stepper = force_move.lookup_stepper(sname)
+            if stepper in self.steppers:
+                raise self.printer.config_error(
+                    "Stepper %s specified twice in '%s'"
+                    % (sname, self.name))
+            self.steppers.append(stepper)
+        self.mcu = mcu = self.steppers[0].get_mcu()
+        for stepper in self.steppers:
+            if stepper.get_mcu() is not mcu:
+                raise self.printer.config_error(
+                    "All steppers in '%s' must be on the same mcu"
+                    % (self.name,))
+        if mcu.try_lookup_command(
+                "stepper_position_stream_add oid=%c stepper_oid=%c") is None:
+            raise self.printer.config_error(
+                "MCU '%s' does not support stepper position streams"
+                % (mcu.get_name(),))
+        self.oid = oid = mcu.create_oid()
+        mcu.register_config_callback(self._build_config)
+        self.bulk_queue = bulk_sensor.BulkDataQueue(mcu, oid=oid)
+    def _build_config(self):
+        self.mcu.add_config_cmd(
+            "config_stepper_position_stream oid=%d stepper_count=%d"
+            % (self.oid, len(self.steppers)))
+        for stepper in self.steppers:
+            self.mcu.add_config_cmd(
+                "stepper_position_stream_add oid=%d stepper_oid=%d"
+                % (self.oid, stepper.get_oid()))
+        self.mcu.add_config_cmd(
+            "query_stepper_position_stream oid=%d clock=0 rest_ticks=0"
+            % (self.oid,), on_restart=True)
+        self.query_cmd = self.mcu.lookup_command(
+            "query_stepper_position_stream oid=%c clock=%u rest_ticks=%u")
+    def add_client(self, client_cb):
+        self.batch_bulk.add_client(client_cb)
+    # Measurement decoding
+    def _extract_samples(self, raw_samples):
+        # Load variables to optimize inner loop below
+        sample_ticks = self.sample_ticks
+        start_clock = self.start_clock
+        clock_to_print_time = self.mcu.clock_to_print_time
+        samples_per_block = self.samples_per_block
+        last_sequence = self.last_sequence
+        steppers = [(s, -1 if s.get_dir_inverted()[0] else 1)
+                    for s in self.steppers]
+        sample_size = BYTES_PER_POSITION * len(steppers)
+        # Process every message in raw_samples
+        count = error_count = 0
+        samples = [None] * (len(raw_samples) * samples_per_block)
+        for params in raw_samples:
+            seq_diff = (params['sequence'] - last_sequence) & 0xffff
+            last_sequence += seq_diff
+            msg_mclock = start_clock + (last_sequence * samples_per_block
+                                        * sample_ticks)
+            d = bytearray(params['data'])
+            for i in range(len(d) // sample_size):
+                pos = i * sample_size
+                row = []
+                for j in range(len(steppers)):
+                    mpos = (d[pos] | (d[pos+1] << 8) | (d[pos+2] << 16)
+                            | (d[pos+3] << 24))
+                    row.append(mpos - ((mpos & 0x80000000) << 1))
+                    pos += BYTES_PER_POSITION
+                if row[0] == POSITION_ERROR:
+                    error_count += 1
+                    continue
+                ptime = clock_to_print_time(msg_mclock + i*sample_ticks)
+                sample = [round(ptime, 6)]
+                for (stepper, sign), mpos in zip(steppers, row):
+                    sample.append(mpos * sign)
+                    sample.append(stepper.get_past_mcu_position(ptime))
+                samples[count] = tuple(sample)
+                count += 1
+        self.last_sequence = last_sequence
+        del samples[count:]
+        return samples, error_count
+    # Start, stop, and process message batches
+    def _start_measurements(self):
+        logging.info("Starting stepper position stream '%s'", self.name)
+        self.bulk_queue.clear_queue()
+        self.last_sequence = 0
+        systime = self.printer.get_reactor().monotonic()
+        print_time = self.mcu.estimated_print_time(systime) + MIN_MSG_TIME
+        self.start_clock = reqclock = self.mcu.print_time_to_clock(print_time)
+        self.sample_ticks = self.mcu.seconds_to_clock(self.sample_period)
+        self.query_cmd.send([self.oid, reqclock, self.sample_ticks],
+                            reqclock=reqclock)
+    def _finish_measurements(self):
+        # Halt bulk reading
+        self.query_cmd.send_wait_ack([self.oid, 0, 0])
+        self.bulk_queue.clear_queue()
+        logging.info("Stopped stepper position stream '%s'", self.name)
+    def _process_batch(self, eventtime):
+        raw_samples = self.bulk_queue.pull_queue()
+        if not raw_samples:
+            return {}
+        samples, error_count = self._extract_samples(raw_samples)
+        if not samples:
+            return {}
+        return {'data': samples, 'errors': error_count}
+
+def load_config_prefix(config):
+    return StepperPositionStream(config)
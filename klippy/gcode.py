@@ -22,15 +22,20 @@ class Coord(tuple):
 
 # Class for handling gcode command parameters (gcmd)
 class GCodeCommand:
+    # A GCodeCommand is created for every g-code line
+    __slots__ = ('_gcode', '_command', '_commandline', '_params', '_need_ack')
     error = CommandError
     def __init__(self, gcode, command, commandline, params, need_ack):
+        self._gcode = gcode
         self._command = command
         self._commandline = commandline
         self._params = params
         self._need_ack = need_ack
-        # Method wrappers
-        self.respond_info = gcode.respond_info
-        self.respond_raw = gcode.respond_raw
+    # Method wrappers
+    def respond_info(self, msg, log=True):
+        self._gcode.respond_info(msg, log)
+    def respond_raw(self, msg):
+        self._gcode.respond_raw(msg)
     def get_command(self):
         return self._command
     def get_commandline(self):
@@ -163,6 +163,7 @@ class Printer:
                     if self.state_message is not message_ready:
                         return
                     cb()
+            self.reactor.freeze_gc()
         except Exception as e:
             logging.exception("Unhandled exception during ready callback")
             self.invoke_shutdown("Internal error during ready callback: %s"
@@ -271,6 +272,8 @@ def main():
                     help="api server unix domain socket filename")
     opts.add_option("-l", "--logfile", dest="logfile",
                     help="write log to file instead of stderr")
+    opts.add_option("--binary-log", action="store_true", dest="binarylog",
+                    help="write log file in a compact binary format")
     opts.add_option("-v", action="store_true", dest="verbose",
                     help="enable debug messages")
     opts.add_option("-o", "--debugoutput", dest="debugoutput",
@@ -303,7 +306,8 @@ def main():
     bglogger = None
     if options.logfile:
         start_args['log_file'] = options.logfile
-        bglogger = queuelogger.setup_bg_logging(options.logfile, debuglevel)
+        bglogger = queuelogger.setup_bg_logging(options.logfile, debuglevel,
+                                                options.binarylog)
     else:
         logging.getLogger().setLevel(debuglevel)
     logging.info("Starting Klippy...")
@@ -353,6 +357,8 @@ def main():
         if bglogger is not None:
             bglogger.clear_rollover_info()
             bglogger.set_rollover_info('versions', versions)
+        if hasattr(gc, 'unfreeze'):
+            gc.unfreeze()
         gc.collect()
         main_reactor = reactor.Reactor(gc_checking=True)
         printer = Printer(main_reactor, bglogger, start_args)
@@ -304,6 +304,8 @@ class MCU_endstop:
         self._dispatch = TriggerDispatch(mcu)
     def get_mcu(self):
         return self._mcu
+    def get_oid(self):
+        return self._oid
     def add_stepper(self, stepper):
         self._dispatch.add_stepper(stepper)
     def get_steppers(self):
@@ -829,6 +831,7 @@ class MCUStatsHelper:
         self._mcu_tick_avg = 0.
         self._mcu_tick_stddev = 0.
         self._mcu_tick_awake = 0.
+        self._timer_latency = ""
         # Register handlers
         printer.register_event_handler("klippy:ready", self._ready)
         printer.register_event_handler("klippy:mcu_identify",
@@ -842,6 +845,14 @@ class MCUStatsHelper:
         diff = count*tick_sumsq - tick_sum**2
         self._mcu_tick_stddev = c * math.sqrt(max(0., diff))
         self._mcu_tick_awake = tick_sum / self._mcu_freq
+    def _handle_timer_latency(self, params):
+        buckets = ["under_2us", "under_10us", "under_50us", "under_200us",
+                   "under_1ms"]
+        over = params['count'] - sum([params[b] for b in buckets])
+        self._timer_latency = ' '.join(
+            ["timer_latency_max=%.06f" % (params['max'] / self._mcu_freq,)]
+            + ["timer_latency_%s=%d" % (b, params[b]) for b in buckets]
+            + ["timer_latency_over_1ms=%d" % (over,)])
     def _mcu_identify(self):
         self._mcu_freq = self._mcu.get_constant_float('CLOCK_FREQ')
         self._stats_sumsq_base = self._mcu.get_constant_float(
@@ -852,6 +863,8 @@ class MCUStatsHelper:
         self._get_status_info['mcu_build_versions'] = build_versions
         self._get_status_info['mcu_constants'] = msgparser.get_constants()
         self._mcu.register_response(self._handle_mcu_stats, 'stats')
+        self._mcu.register_response(self._handle_timer_latency,
+                                    'timer_latency')
     def _ready(self):
         if self._mcu.is_fileoutput():
             return
@@ -873,8 +886,11 @@ class MCUStatsHelper:
     def stats(self, eventtime):
         load = "mcu_awake=%.03f mcu_task_avg=%.06f mcu_task_stddev=%.06f" % (
             self._mcu_tick_awake, self._mcu_tick_avg, self._mcu_tick_stddev)
+        motion_queuing = self._printer.lookup_object('motion_queuing')
         stats = ' '.join([load, self._serial.stats(eventtime),
-                          self._clocksync.stats(eventtime)])
+                          self._clocksync.stats(eventtime),
+                          motion_queuing.movequeue_stats(self._mcu, eventtime),
+                          self._timer_latency])
         parts = [s.split('=', 1) for s in stats.split()]
         last_stats = {k:(float(v) if '.' in v else int(v)) for k, v in parts}
         self._get_status_info['last_stats'] = last_stats
@@ -1077,9 +1093,9 @@ class MCU:
                              cq=None, is_async=False):
         return CommandQueryWrapper(self._serial, msgformat, respformat, oid,
                                    cq, is_async, self._printer.command_error)
-    def try_lookup_command(self, msgformat):
+    def try_lookup_command(self, msgformat, cq=None):
         try:
-            return self.lookup_command(msgformat)
+            return self.lookup_command(msgformat, cq)
         except self._serial.get_msgparser().error as e:
             return None
     # SerialHdl wrappers
@@ -3,7 +3,10 @@
 # Copyright (C) 2016-2019  Kevin O'Connor <kevin@koconnor.net>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
-import logging, logging.handlers, threading, queue, time
+import logging, logging.handlers, threading, queue, time, struct, json
+
+# Message arguments that may be formatted from the background thread
+DEFERRED_TYPES = (str, int, float, bool, type(None))
 
 # Class to forward all messages through a queue to a background thread
 class QueueHandler(logging.Handler):
@@ -12,6 +15,13 @@ class QueueHandler(logging.Handler):
         self.queue = queue
     def emit(self, record):
         try:
+            args = record.args
+            if (record.exc_info is None and type(record.msg) is str
+                and type(args) is tuple
+                and all([type(a) in DEFERRED_TYPES for a in args])):
+                # Arguments are immutable - format in background thread
+                self.queue.put_nowait(record)
+                return
             self.format(record)
             record.msg = record.message
             record.args = None
@@ -55,11 +65,95 @@ class QueueListener(logging.handlers.TimedRotatingFileHandler):
         self.emit(logging.makeLogRecord(
             {'msg': "\n".join(lines), 'level': logging.INFO}))
 
+# Binary log file format.  The file starts with BINARY_LOG_MAGIC and
+# is followed by records (a 32bit little-endian length followed by a
+# utf8 json array, as produced by Python's json module - so floats may
+# also be NaN, Infinity, or -Infinity).  Message format strings are
+# only stored once - [DEFINE_FORMAT, id, fmt] assigns an id that is
+# then referenced by [FORMAT_MESSAGE, id, args] records.
+# [TEXT_MESSAGE, text] records hold messages without arguments (and
+# messages that were formatted by the caller).
+BINARY_LOG_MAGIC = b"KLIPPYLOG1\n"
+DEFINE_FORMAT, FORMAT_MESSAGE, TEXT_MESSAGE = 0, 1, 2
+RECORD_HEADER = struct.Struct("<I")
+
+# Class to write log messages in the binary log format
+class BinaryQueueListener(QueueListener):
+    def __init__(self, filename):
+        self.formats = {}
+        QueueListener.__init__(self, filename)
+    def _open(self):
+        stream = open(self.baseFilename, 'ab')
+        self.formats = {}
+        if not stream.tell():
+            stream.write(BINARY_LOG_MAGIC)
+        return stream
+    def _write_record(self, data):
+        rec = json.dumps(data, separators=(',', ':')).encode()
+        self.stream.write(RECORD_HEADER.pack(len(rec)) + rec)
+    def emit(self, record):
+        try:
+            if self.shouldRollover(record):
+                self.doRollover()
+            if self.stream is None:
+                self.stream = self._open()
+            if not record.args:
+                msg = record.msg
+                if record.exc_text:
+                    msg = "%s\n%s" % (msg, record.exc_text)
+                self._write_record((TEXT_MESSAGE, msg))
+            else:
+                fmt_id = self.formats.get(record.msg)
+                if fmt_id is None:
+                    fmt_id = self.formats[record.msg] = len(self.formats)
+                    self._write_record((DEFINE_FORMAT, fmt_id, record.msg))
+                self._write_record((FORMAT_MESSAGE, fmt_id, record.args))
+            self.stream.flush()
+        except Exception:
+            self.handleError(record)
+
+# Read the lines of a log file (in either the text or binary format)
+# from a file opened in binary mode
+def read_log_lines(f):
+    if f.read(len(BINARY_LOG_MAGIC)) != BINARY_LOG_MAGIC:
+        f.seek(0)
+        for line in f:
+            yield line.decode(errors='replace')
+        return
+    formats = {}
+    while 1:
+        hdr = f.read(RECORD_HEADER.size)
+        if len(hdr) < RECORD_HEADER.size:
+            break
+        rec = f.read(RECORD_HEADER.unpack(hdr)[0])
+        try:
+            data = json.loads(rec.decode())
+        except ValueError:
+            # Truncated record
+            break
+        if data[0] == DEFINE_FORMAT:
+            formats[data[1]] = data[2]
+            continue
+        if data[0] == FORMAT_MESSAGE:
+            fmt = formats[data[1]]
+            args = tuple(data[2])
+            try:
+                msg = fmt % args
+            except (TypeError, ValueError):
+                msg = "%s %s" % (fmt, args)
+        else:
+            msg = data[1]
+        for line in msg.split('\n'):
+            yield line + '\n'
+
 MainQueueHandler = None
 
-def setup_bg_logging(filename, debuglevel):
+def setup_bg_logging(filename, debuglevel, binary=False):
     global MainQueueHandler
-    ql = QueueListener(filename)
+    if binary:
+        ql = BinaryQueueListener(filename)
+    else:
+        ql = QueueListener(filename)
     MainQueueHandler = QueueHandler(ql.bg_queue)
     root = logging.getLogger()
     root.addHandler(MainQueueHandler)
@@ -3,7 +3,8 @@
 # Copyright (C) 2016-2025  Kevin O'Connor <kevin@koconnor.net>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
-import os, gc, select, math, time, logging, queue
+import sys, os, gc, select, math, time, logging, queue, heapq, itertools
+import bisect
 import greenlet
 import chelper, util
 
@@ -18,6 +19,9 @@ class ReactorTimer:
         self.callback = callback
         self.waketime = waketime
         self.timer_is_running = False
+        self.is_registered = True
+        self.heap_entry = None
+        self.profile_stats = None
 
 class ReactorCompletion:
     class sentinel: pass
@@ -58,6 +62,7 @@ class ReactorFileHandler:
         self.fd = fd
         self.read_callback = read_callback
         self.write_callback = write_callback
+        self.read_stats = self.write_stats = None
 
 class ReactorGreenlet(greenlet.greenlet):
     def __init__(self, run):
@@ -101,6 +106,125 @@ class ReactorPreventPause:
     def __exit__(self, type=None, value=None, tb=None):
         self.reactor._prevent_pause_count -= 1
 
+# Upper limits (in seconds) of the profiling histogram buckets
+PROFILE_BUCKETS = [.000010, .000100, .001, .010, .100, 1.]
+
+# Timing statistics for one reactor callback
+class ReactorProfileStats:
+    def __init__(self, kind, name):
+        self.kind = kind
+        self.name = name
+        self.reset()
+    def reset(self):
+        self.count = 0
+        self.total_time = self.max_time = self.max_lateness = 0.
+        self.time_buckets = [0] * (len(PROFILE_BUCKETS) + 1)
+        self.lateness_buckets = [0] * (len(PROFILE_BUCKETS) + 1)
+    def get_status(self):
+        return {'type': self.kind, 'name': self.name, 'count': self.count,
+                'total_time': self.total_time, 'max_time': self.max_time,
+                'max_lateness': self.max_lateness,
+                'time_histogram': list(self.time_buckets),
+                'lateness_histogram': list(self.lateness_buckets)}
+
+# Return a descriptive name (module and function name) for a callback
+def _callback_name(callback):
+    func = getattr(callback, 'func', callback) # functools.partial
+    func = getattr(func, '__func__', func)
+    qualname = getattr(func, '__qualname__', None)
+    if qualname is None:
+        return type(callback).__name__
+    module = getattr(func, '__module__', None)
+    if module is None:
+        return qualname
+    return "%s:%s" % (module, qualname)
+
+# Track the time spent in each timer, fd, and greenlet callback.  A
+# greenlet that pauses stops the accounting of the callback it was
+# running - the remainder is charged to the pause() caller on resume.
+class ReactorProfiler:
+    def __init__(self, reactor):
+        self.monotonic = reactor.monotonic
+        self.stats = {}
+        self.pause_stats = {}
+        self.cur_stats = None
+        self.cur_start = 0.
+    def _lookup_stats(self, kind, name):
+        stats = self.stats.get((kind, name))
+        if stats is None:
+            stats = self.stats[(kind, name)] = ReactorProfileStats(kind, name)
+        return stats
+    def _begin(self, stats, sched_time):
+        start = self.monotonic()
+        lateness = start - sched_time
+        if lateness > stats.max_lateness:
+            stats.max_lateness = lateness
+        stats.lateness_buckets[bisect.bisect(PROFILE_BUCKETS, lateness)] += 1
+        self.cur_stats = stats
+        self.cur_start = start
+    def end(self):
+        stats = self.cur_stats
+        if stats is None:
+            return
+        self.cur_stats = None
+        run_time = self.monotonic() - self.cur_start
+        stats.count += 1
+        stats.total_time += run_time
+        if run_time > stats.max_time:
+            stats.max_time = run_time
+        stats.time_buckets[bisect.bisect(PROFILE_BUCKETS, run_time)] += 1
+    def run_timer(self, t, waketime, eventtime):
+        stats = t.profile_stats
+        if stats is None:
+            callback = t.callback
+            rcb = getattr(callback, '__self__', None)
+            if isinstance(rcb, ReactorCallback):
+                stats = self._lookup_stats('callback',
+                                           _callback_name(rcb.callback))
+            else:
+                stats = self._lookup_stats('timer', _callback_name(callback))
+            t.profile_stats = stats
+        # Lateness of timers scheduled for NOW is measured from eventtime
+        self._begin(stats, waketime if waketime > _NOW else eventtime)
+        res = t.callback(eventtime)
+        self.end()
+        return res
+    def run_fd(self, hdl, is_write, eventtime):
+        if is_write:
+            stats = hdl.write_stats
+            if stats is None:
+                stats = hdl.write_stats = self._lookup_stats(
+                    'fd', _callback_name(hdl.write_callback))
+            callback = hdl.write_callback
+        else:
+            stats = hdl.read_stats
+            if stats is None:
+                stats = hdl.read_stats = self._lookup_stats(
+                    'fd', _callback_name(hdl.read_callback))
+            callback = hdl.read_callback
+        self._begin(stats, eventtime)
+        callback(eventtime)
+        self.end()
+    def note_pause(self, timer):
+        # Find the caller of pause() (skipping reactor internal frames)
+        self.end()
+        frame = sys._getframe(2)
+        while frame.f_code.co_filename == __file__ and frame.f_back:
+            frame = frame.f_back
+        code = frame.f_code
+        stats = self.pause_stats.get(code)
+        if stats is None:
+            name = "%s:%s" % (frame.f_globals.get('__name__'),
+                              getattr(code, 'co_qualname', code.co_name))
+            stats = self.pause_stats[code] = self._lookup_stats('greenlet',
+                                                                name)
+        timer.profile_stats = stats
+    def get_stats(self):
+        return list(self.stats.values())
+    def reset(self):
+        for stats in self.stats.values():
+            stats.reset()
+
 class SelectReactor:
     NOW = _NOW
     NEVER = _NEVER
@@ -111,8 +235,11 @@ class SelectReactor:
         # Python garbage collection
         self._check_gc = gc_checking
         self._last_gc_times = [0., 0., 0.]
-        # Timers
-        self._timers = []
+        # Timers - a heap of [waketime, sequence, timer] entries (an
+        # entry is invalidated by clearing its timer instead of removing it)
+        self._timer_heap = []
+        self._timer_seq = itertools.count()
+        self._timer_count = self._stale_timers = 0
         self._next_timer = self.NEVER
         # Callbacks
         self._pipe_fds = None
@@ -130,26 +257,58 @@ class SelectReactor:
         self._greenlets = []
         self._all_greenlets = []
         self._prevent_pause_count = 0
+        # Callback profiling
+        self._profiler = None
     def get_gc_stats(self):
         return tuple(self._last_gc_times)
+    def freeze_gc(self):
+        # Move all current objects to the permanent generation so that
+        # later collections do not need to scan the startup state
+        if self._check_gc and hasattr(gc, 'freeze'):
+            gc.collect()
+            gc.freeze()
+    def setup_profiler(self):
+        if self._profiler is None:
+            self._profiler = ReactorProfiler(self)
+        return self._profiler
     # Timers
+    def _schedule_timer(self, timer_handler, waketime):
+        timer_handler.waketime = waketime
+        entry = timer_handler.heap_entry
+        if entry is not None:
+            if entry[0] == waketime:
+                return
+            entry[2] = None
+            self._stale_timers += 1
+            timer_handler.heap_entry = None
+        if waketime >= self.NEVER or not timer_handler.is_registered:
+            return
+        heap = self._timer_heap
+        if self._stale_timers > self._timer_count + 64:
+            # Discard invalidated entries (in place, as _check_timers()
+            # may be active in a paused greenlet)
+            heap[:] = [e for e in heap if e[2] is not None]
+            heapq.heapify(heap)
+            self._stale_timers = 0
+        entry = [waketime, next(self._timer_seq), timer_handler]
+        timer_handler.heap_entry = entry
+        heapq.heappush(heap, entry)
+        if waketime < self._next_timer:
+            self._next_timer = waketime
     def update_timer(self, timer_handler, waketime):
         if timer_handler.timer_is_running:
             return
-        timer_handler.waketime = waketime
-        self._next_timer = min(self._next_timer, waketime)
+        self._schedule_timer(timer_handler, waketime)
     def register_timer(self, callback, waketime=NEVER):
-        timer_handler = ReactorTimer(callback, waketime)
-        timers = list(self._timers)
-        timers.append(timer_handler)
-        self._timers = timers
-        self._next_timer = min(self._next_timer, waketime)
+        timer_handler = ReactorTimer(callback, self.NEVER)
+        self._timer_count += 1
+        self._schedule_timer(timer_handler, waketime)
         return timer_handler
     def unregister_timer(self, timer_handler):
-        timer_handler.waketime = self.NEVER
-        timers = list(self._timers)
-        timers.pop(timers.index(timer_handler))
-        self._timers = timers
+        if timer_handler.is_registered:
+            self._timer_count -= 1
+        self._schedule_timer(timer_handler, self.NEVER)
+        timer_handler.is_registered = False
     def _check_timers(self, eventtime, busy):
         if eventtime < self._next_timer:
             if busy:
@@ -167,20 +326,47 @@ class SelectReactor:
                     gc.collect(gc_level)
                     return 0.
             return min(1., max(.001, self._next_timer - eventtime))
-        self._next_timer = self.NEVER
         g_dispatch = self._g_dispatch
-        for t in self._timers:
-            waketime = t.waketime
-            if eventtime >= waketime:
-                t.waketime = self.NEVER
-                t.timer_is_running = True
-                t.waketime = waketime = t.callback(eventtime)
-                t.timer_is_running = False
-                if g_dispatch is not self._g_dispatch:
-                    self._next_timer = min(self._next_timer, waketime)
-                    self._end_greenlet(g_dispatch)
-                    return 0.
-            self._next_timer = min(self._next_timer, waketime)
+        heap = self._timer_heap
+        prof = self._profiler
+        # Only run timers scheduled prior to this pass (a timer added or
+        # rescheduled in the past is held back until the next pass).  The
+        # held back entries are put back on the heap before each callback
+        # so that they can still run from a greenlet if a callback pauses.
+        last_seq = next(self._timer_seq)
+        held = []
+        while heap:
+            entry = heap[0]
+            t = entry[2]
+            if t is None:
+                heapq.heappop(heap)
+                self._stale_timers -= 1
+                continue
+            if eventtime < entry[0]:
+                break
+            heapq.heappop(heap)
+            if entry[1] > last_seq:
+                held.append(entry)
+                continue
+            if held:
+                for h in held:
+                    heapq.heappush(heap, h)
+                del held[:]
+            t.heap_entry = None
+            t.waketime = self.NEVER
+            t.timer_is_running = True
+            if prof is None:
+                waketime = t.callback(eventtime)
+            else:
+                waketime = prof.run_timer(t, entry[0], eventtime)
+            t.timer_is_running = False
+            self._schedule_timer(t, waketime)
+            if g_dispatch is not self._g_dispatch:
+                self._end_greenlet(g_dispatch)
+                return 0.
+        for h in held:
+            heapq.heappush(heap, h)
+        self._next_timer = heap[0][0] if heap else self.NEVER
         return 0.
     # Callbacks and Completions
     def completion(self):
@@ -233,6 +419,8 @@ class SelectReactor:
             # Switch to _check_timers (via g.timer.callback return)
             if self._prevent_pause_count:
                 self.verify_can_pause()
+            if self._profiler is not None:
+                self._profiler.note_pause(g.timer)
             return self._g_dispatch.switch(waketime)
         # Pausing the dispatch greenlet - prepare a new greenlet to do dispatch
         if self._prevent_pause_count:
@@ -244,6 +432,8 @@ class SelectReactor:
             self._all_greenlets.append(g_next)
         g_next.parent = g.parent
         g.timer = self.register_timer(g.switch, waketime)
+        if self._profiler is not None:
+            self._profiler.note_pause(g.timer)
         self._next_timer = self.NOW
         # Switch to _dispatch_loop (via _end_greenlet or direct)
         eventtime = g_next.switch()
@@ -290,15 +480,22 @@ class SelectReactor:
             self._write_fds.append(fd)
     def _check_fds(self, eventtime, hdls):
         g_dispatch = self._g_dispatch
+        prof = self._profiler
         for fd, event in hdls:
             hdl = self._fds.get(fd, self._dummy_fd_hdl)
             if event & self._READ:
-                hdl.read_callback(eventtime)
+                if prof is None:
+                    hdl.read_callback(eventtime)
+                else:
+                    prof.run_fd(hdl, False, eventtime)
                 if g_dispatch is not self._g_dispatch:
                     self._end_greenlet(g_dispatch)
                     return self.monotonic()
             if event & self._WRITE:
-                hdl.write_callback(eventtime)
+                if prof is None:
+                    hdl.write_callback(eventtime)
+                else:
+                    prof.run_fd(hdl, True, eventtime)
                 if g_dispatch is not self._g_dispatch:
                     self._end_greenlet(g_dispatch)
                     return self.monotonic()
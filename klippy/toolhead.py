@@ -12,17 +12,26 @@ import mcu, chelper, kinematics.extruder
 
 # Class to track each move request
 class Move:
+    # A Move is created for every g-code move - avoid a per-instance dict
+    __slots__ = ('toolhead', 'start_pos', 'end_pos', 'accel',
+                 'junction_deviation', 'timing_callbacks', 'is_kinematic_move',
+                 'axes_d', 'move_d', 'axes_r', 'min_move_t', 'max_start_v2',
+                 'max_cruise_v2', 'delta_v2', 'next_junction_v2',
+                 'max_mcr_start_v2', 'mcr_delta_v2', 'start_v', 'cruise_v',
+                 'end_v', 'accel_t', 'cruise_t', 'decel_t')
     def __init__(self, toolhead, start_pos, end_pos, speed):
         self.toolhead = toolhead
         self.start_pos = tuple(start_pos)
         self.end_pos = tuple(end_pos)
         self.accel = toolhead.max_accel
         self.junction_deviation = toolhead.junction_deviation
-        self.timing_callbacks = []
+        self.timing_callbacks = ()
         velocity = min(speed, toolhead.max_velocity)
         self.is_kinematic_move = True
-        self.axes_d = axes_d = [ep - sp for sp, ep in zip(start_pos, end_pos)]
-        self.move_d = move_d = math.sqrt(sum([d*d for d in axes_d[:3]]))
+        axes_d = [ep - sp for sp, ep in zip(start_pos, end_pos)]
+        self.move_d = move_d = math.sqrt(axes_d[0]*axes_d[0]
+                                         + axes_d[1]*axes_d[1]
+                                         + axes_d[2]*axes_d[2])
         if move_d < .000000001:
             # Extrude only move
             self.end_pos = ((start_pos[0], start_pos[1], start_pos[2])
@@ -37,7 +46,9 @@ class Move:
             self.is_kinematic_move = False
         else:
             inv_move_d = 1. / move_d
-        self.axes_r = [d * inv_move_d for d in axes_d]
+        # Tuples use less memory than lists
+        self.axes_d = tuple(axes_d)
+        self.axes_r = tuple([d * inv_move_d for d in axes_d])
         self.min_move_t = move_d / velocity
         # Junction speeds are tracked in velocity squared.  The
         # delta_v2 is the maximum amount of this squared-velocity that
@@ -66,13 +77,13 @@ class Move:
     def calc_junction(self, prev_move):
         if not self.is_kinematic_move or not prev_move.is_kinematic_move:
             return
+        max_start_v2 = min(self.max_cruise_v2,
+                           prev_move.max_cruise_v2, prev_move.next_junction_v2,
+                           prev_move.max_start_v2 + prev_move.delta_v2)
         # Allow extra axes to calculate maximum junction
-        ea_v2 = [ea.calc_junction(prev_move, self, e_index+3)
-                 for e_index, ea in enumerate(self.toolhead.extra_axes)]
-        max_start_v2 = min([self.max_cruise_v2,
-                            prev_move.max_cruise_v2, prev_move.next_junction_v2,
-                            prev_move.max_start_v2 + prev_move.delta_v2]
-                           + ea_v2)
+        for e_index, ea in enumerate(self.toolhead.extra_axes):
+            max_start_v2 = min(max_start_v2,
+                               ea.calc_junction(prev_move, self, e_index+3))
         # Find max velocity using "approximated centripetal velocity"
         axes_r = self.axes_r
         prev_axes_r = prev_move.axes_r
@@ -113,6 +124,23 @@ class Move:
         self.cruise_t = cruise_d / cruise_v
         self.decel_t = decel_d / ((end_v + cruise_v) * 0.5)
 
+# Flat array of per-move records for a batch of moves (for the extra axes)
+class MoveBatch:
+    def __init__(self, moves, move_data):
+        self.moves = moves
+        self.count = len(moves)
+        self.num_axes = len(moves[0].start_pos)
+        ffi_main, ffi_lib = chelper.get_ffi()
+        self.data = ffi_main.new("double[]", move_data)
+        self.trapq_append_batch = ffi_lib.trapq_append_batch
+    def append_axis(self, trapq, ea_index, mark_xy=False):
+        # Queue moves involving the axis and return its final position
+        last = self.trapq_append_batch(trapq, self.data, self.count,
+                                       self.num_axes, ea_index, mark_xy)
+        if last < 0:
+            return None
+        return self.moves[last].end_pos[ea_index]
+
 LOOKAHEAD_FLUSH_TIME = 0.150
 
 # Class to track a list of pending move requests and to facilitate
@@ -120,12 +148,15 @@ LOOKAHEAD_FLUSH_TIME = 0.150
 class LookAheadQueue:
     def __init__(self):
         self.queue = []
+        self.lookahead_time = LOOKAHEAD_FLUSH_TIME
         self.junction_flush = LOOKAHEAD_FLUSH_TIME
     def reset(self):
         del self.queue[:]
-        self.junction_flush = LOOKAHEAD_FLUSH_TIME
+        self.junction_flush = self.lookahead_time
     def set_flush_time(self, flush_time):
         self.junction_flush = flush_time
+    def set_lookahead_time(self, lookahead_time):
+        self.lookahead_time = lookahead_time
     def is_empty(self):
         return not self.queue
     def get_last(self):
@@ -133,7 +164,7 @@ class LookAheadQueue:
             return self.queue[-1]
         return None
     def flush(self, lazy=False):
-        self.junction_flush = LOOKAHEAD_FLUSH_TIME
+        self.junction_flush = self.lookahead_time
         update_flush_count = lazy
         queue = self.queue
         flush_count = len(queue)
@@ -202,8 +233,10 @@ class ToolHead:
         self.printer = config.get_printer()
         self.reactor = self.printer.get_reactor()
         self.mcu = self.printer.lookup_object('mcu')
+        self.buffer_time_high = BUFFER_TIME_HIGH
+        self.buffer_time_start = BUFFER_TIME_START
         self.lookahead = LookAheadQueue()
-        self.lookahead.set_flush_time(BUFFER_TIME_HIGH)
+        self.lookahead.set_flush_time(self.buffer_time_high)
         self.commanded_pos = [0., 0., 0., 0.]
         # Velocity and acceleration control
         self.max_velocity = config.getfloat('max_velocity', above=0.)
@@ -214,6 +247,7 @@ class ToolHead:
             'square_corner_velocity', 5., minval=0.)
         self.junction_deviation = self.mcr_pseudo_accel = 0.
         self._calc_junction_deviation()
+        self.accel_order = config.getchoice('accel_order', [2, 4, 6], 2)
         # Input stall detection
         self.check_stall_time = 0.
         self.print_stall = 0
@@ -232,6 +266,9 @@ class ToolHead:
                                                     can_add_trapq=True)
         self.trapq = self.motion_queuing.allocate_trapq()
         self.trapq_append = self.motion_queuing.lookup_trapq_append()
+        self.motion_queuing.set_trapq_accel_order(self.trapq, self.accel_order)
+        if config.getboolean('adaptive_flush', False):
+            self.motion_queuing.enable_adaptive_flush()
         # Create kinematics class
         gcode = self.printer.lookup_object('gcode')
         self.Coord = gcode.Coord
@@ -254,6 +291,8 @@ class ToolHead:
         # Register handlers
         self.printer.register_event_handler("klippy:shutdown",
                                             self._handle_shutdown)
+        self.printer.register_event_handler("motion_queuing:flush_scale",
+                                            self._handle_flush_scale)
     # Print time tracking
     def _advance_move_time(self, next_print_time):
         self.print_time = max(self.print_time, next_print_time)
@@ -261,7 +300,7 @@ class ToolHead:
         curtime = self.reactor.monotonic()
         est_print_time = self.mcu.estimated_print_time(curtime)
         kin_time = self.motion_queuing.calc_step_gen_restart(est_print_time)
-        min_print_time = max(est_print_time + BUFFER_TIME_START, kin_time)
+        min_print_time = max(est_print_time + self.buffer_time_start, kin_time)
         if min_print_time > self.print_time:
             self.print_time = min_print_time
             self.printer.send_event("toolhead:sync_print_time",
@@ -278,6 +317,7 @@ class ToolHead:
             self._calc_print_time()
         # Queue moves into trapezoid motion queue (trapq)
         next_move_time = self.print_time
+        move_data = []
         with self.reactor.assert_no_pause():
             for move in moves:
                 if move.is_kinematic_move:
@@ -287,13 +327,19 @@ class ToolHead:
                         move.start_pos[0], move.start_pos[1], move.start_pos[2],
                         move.axes_r[0], move.axes_r[1], move.axes_r[2],
                         move.start_v, move.cruise_v, move.accel)
-                for e_index, ea in enumerate(self.extra_axes):
-                    if move.axes_d[e_index + 3]:
-                        ea.process_move(next_move_time, move, e_index + 3)
+                move_data.extend((next_move_time, move.accel_t, move.cruise_t,
+                                  move.decel_t, move.start_v, move.cruise_v,
+                                  move.accel))
+                move_data.extend(move.start_pos)
+                move_data.extend(move.axes_r)
                 next_move_time = (next_move_time + move.accel_t
                                   + move.cruise_t + move.decel_t)
                 for cb in move.timing_callbacks:
                     cb(next_move_time)
+            # Queue extra axis movement (one batch per axis)
+            batch = MoveBatch(moves, move_data)
+            for e_index, ea in enumerate(self.extra_axes):
+                ea.process_moves(batch, e_index + 3)
         # Generate steps for moves
         self._advance_move_time(next_move_time)
         self.motion_queuing.note_mcu_movequeue_activity(next_move_time)
@@ -303,7 +349,7 @@ class ToolHead:
         self._process_lookahead()
         self.special_queuing_state = "NeedPrime"
         self.need_check_pause = -1.
-        self.lookahead.set_flush_time(BUFFER_TIME_HIGH)
+        self.lookahead.set_flush_time(self.buffer_time_high)
         self.check_stall_time = 0.
         if is_runout and prev_print_time != self.print_time:
             self.check_stall_time = self.print_time
@@ -350,7 +396,8 @@ class ToolHead:
         if self.priming_timer is None:
             self.priming_timer = self.reactor.register_timer(
                 self._priming_handler)
-        will_pause_time = self.print_time - est_print_time - BUFFER_TIME_HIGH
+        will_pause_time = (self.print_time - est_print_time
+                           - self.buffer_time_high)
         wtime = eventtime + max(0., will_pause_time) + PRIMING_CMD_TIME
         self.reactor.update_timer(self.priming_timer, wtime)
     def _check_pause(self):
@@ -362,7 +409,8 @@ class ToolHead:
         did_pause = False
         while 1:
             est_print_time = self.mcu.estimated_print_time(eventtime)
-            pause_time = self.print_time - est_print_time - BUFFER_TIME_HIGH
+            pause_time = (self.print_time - est_print_time
+                          - self.buffer_time_high)
             if pause_time <= 0.:
                 break
             if not self.can_pause:
@@ -514,11 +562,17 @@ class ToolHead:
                      'max_accel': self.max_accel,
                      'minimum_cruise_ratio': self.min_cruise_ratio,
                      'square_corner_velocity': self.square_corner_velocity,
+                     'accel_order': self.accel_order,
                      'extra_axes': self.extra_axes_status})
         return res
     def _handle_shutdown(self):
         self.can_pause = False
         self.lookahead.reset()
+    def _handle_flush_scale(self, scale):
+        # Adaptive flush timing - scale lookahead and buffering times
+        self.buffer_time_high = BUFFER_TIME_HIGH * scale
+        self.buffer_time_start = BUFFER_TIME_START * scale
+        self.lookahead.set_lookahead_time(LOOKAHEAD_FLUSH_TIME * scale)
     def get_kinematics(self):
         return self.kin
     def get_trapq(self):
@@ -528,9 +582,14 @@ class ToolHead:
         if last_move is None:
             callback(self.get_last_move_time())
             return
+        if not last_move.timing_callbacks:
+            # Moves share an empty tuple until a callback is registered
+            last_move.timing_callbacks = []
         last_move.timing_callbacks.append(callback)
     def get_max_velocity(self):
         return self.max_velocity, self.max_accel
+    def get_accel_order(self):
+        return self.accel_order
     def _calc_junction_deviation(self):
         scv2 = self.square_corner_velocity**2
         self.junction_deviation = scv2 * (math.sqrt(2.) - 1.) / self.max_accel
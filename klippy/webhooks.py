@@ -32,12 +32,51 @@ except ImportError:
         return json.dumps(obj, separators=(',', ':')).encode()
     def json_loads(data):
         return json.loads(data, object_hook=json_loads_byteify)
+    try:
+        import orjson
+    except ImportError:
+        pass
+    else:
+        # orjson does not encode tuple subclasses (eg, namedtuples)
+        def orjson_default(obj):
+            if isinstance(obj, tuple):
+                return list(obj)
+            raise TypeError("Type is not JSON serializable: %s"
+                            % (type(obj).__name__,))
+        def json_dumps(obj):
+            return orjson.dumps(obj, default=orjson_default,
+                                option=orjson.OPT_NON_STR_KEYS)
 else:
     json_dumps = msgspec.json.encode
     json_loads = msgspec.json.decode
 
 REQUEST_LOG_SIZE = 20
 
+# Messages are encoded on the reactor thread (the json encoders hold
+# the GIL, so encoding from another thread would not reduce the delay
+# of reactor timers).  An encoding error is a code defect and results
+# in a printer shutdown.
+def encode_message(printer, data):
+    try:
+        if isinstance(data, BinaryMessage):
+            return data.encode()
+        return json_dumps(data)
+    except Exception as e:
+        msg = ("json encoding error: %s" % (str(e),))
+        logging.exception(msg)
+        printer.invoke_shutdown(msg)
+        return None
+
+# A message followed by binary data.  The pack_cb callback returns the
+# message and binary data.
+class BinaryMessage:
+    def __init__(self, pack_cb):
+        self.pack_cb = pack_cb
+    def encode(self):
+        data, payload = self.pack_cb()
+        data['binary_size'] = len(payload)
+        return json_dumps(data) + b"\x03" + payload
+
 class WebRequestError(gcode.CommandError):
     def __init__(self, message,):
         Exception.__init__(self, message)
@@ -279,15 +318,19 @@ class ClientConnection:
             return
         self.send(result)
 
-    def send(self, data):
-        try:
-            jmsg = json_dumps(data)
-            self.send_buffer += jmsg + b"\x03"
-        except (TypeError, ValueError) as e:
-            msg = ("json encoding error: %s" % (str(e),))
-            logging.exception(msg)
-            self.printer.invoke_shutdown(msg)
-            return
+    def send(self, data, droppable=False):
+        # Returns False if the message was not sent.  A droppable
+        # message is discarded while the client is not keeping up.
+        if self.fd_handle is None or (droppable and self.is_blocking):
+            return False
+        jmsg = encode_message(self.printer, data)
+        if jmsg is None:
+            return False
+        self.send_encoded(jmsg)
+        return True
+
+    def send_encoded(self, jmsg):
+        self.send_buffer += jmsg + b"\x03"
         if not self.is_blocking:
             self._do_send()
 
@@ -468,13 +511,25 @@ class GCodeHelper:
 
 SUBSCRIPTION_REFRESH_TIME = .25
 
+# Subscribers with identical requests share the diff and json encoding
+class StatusSubscription:
+    def __init__(self, objects, template):
+        self.request = dict(objects)
+        self.subscription = dict(objects)
+        self.template = template
+        self.clients = []
+    def matches(self, objects, template):
+        return self.request == objects and self.template == template
+
 class QueryStatusHelper:
     def __init__(self, printer):
         self.printer = printer
         self.clients = {}
+        self.subscriptions = []
         self.pending_queries = []
         self.query_timer = None
         self.last_query = {}
+        self.last_versions = {}
         # Register webhooks
         webhooks = printer.lookup_object('webhooks')
         webhooks.register_endpoint("objects/list", self._handle_list)
@@ -484,34 +539,55 @@ class QueryStatusHelper:
         objects = [n for n, o in self.printer.lookup_objects()
                    if hasattr(o, 'get_status')]
         web_request.send({'objects': objects})
+    def _lookup_status(self, obj_name, eventtime, last_query, versions,
+                       unchanged):
+        po = self.printer.lookup_object(obj_name, None)
+        if po is None or not hasattr(po, 'get_status'):
+            return {}
+        # Objects may report a status version that changes whenever
+        # their get_status() result changes - skip unchanged objects
+        get_status_version = getattr(po, 'get_status_version', None)
+        if get_status_version is not None:
+            version = versions[obj_name] = get_status_version()
+            if (obj_name in last_query
+                and self.last_versions.get(obj_name) == version):
+                unchanged[obj_name] = True
+                return last_query[obj_name]
+        return po.get_status(eventtime)
     def _do_query(self, eventtime):
         last_query = self.last_query
         query = self.last_query = {}
+        versions = {}
+        unchanged = {}
         msglist = self.pending_queries
         self.pending_queries = []
-        msglist.extend(self.clients.values())
+        for sub in list(self.subscriptions):
+            for cconn in [c for c in sub.clients if c.is_closed()]:
+                sub.clients.remove(cconn)
+                del self.clients[cconn]
+            if not sub.clients:
+                self.subscriptions.remove(sub)
+                continue
+            msglist.append((sub, sub.subscription, None, sub.template))
         # Generate get_status() info for each client
         reactor = self.printer.get_reactor()
         with reactor.assert_no_pause():
-            for cconn, subscription, send_func, template in msglist:
-                is_query = cconn is None
-                if not is_query and cconn.is_closed():
-                    del self.clients[cconn]
-                    continue
+            for sub, subscription, send_func, template in msglist:
+                is_query = sub is None
                 # Query each requested printer object
                 cquery = {}
                 for obj_name, req_items in subscription.items():
                     res = query.get(obj_name, None)
                     if res is None:
-                        po = self.printer.lookup_object(obj_name, None)
-                        if po is None or not hasattr(po, 'get_status'):
-                            res = query[obj_name] = {}
-                        else:
-                            res = query[obj_name] = po.get_status(eventtime)
+                        res = query[obj_name] = self._lookup_status(
+                            obj_name, eventtime, last_query, versions,
+                            unchanged)
                     if req_items is None:
                         req_items = list(res.keys())
                         if req_items:
                             subscription[obj_name] = req_items
+                    if not is_query and obj_name in unchanged:
+                        continue
                     lres = last_query.get(obj_name, {})
                     cres = {}
                     for ri in req_items:
@@ -521,10 +597,19 @@ class QueryStatusHelper:
                     if cres or is_query:
                         cquery[obj_name] = cres
                 # Send data
-                if cquery or is_query:
-                    tmp = dict(template)
-                    tmp['params'] = {'eventtime': eventtime, 'status': cquery}
+                if not cquery and not is_query:
+                    continue
+                tmp = dict(template)
+                tmp['params'] = {'eventtime': eventtime, 'status': cquery}
+                if is_query:
                     send_func(tmp)
+                    continue
+                jmsg = encode_message(self.printer, tmp)
+                if jmsg is None:
+                    break
+                for cconn in sub.clients:
+                    cconn.send_encoded(jmsg)
+        self.last_versions = versions
         if not query:
             # Unregister timer if there are no longer any subscriptions
             reactor.unregister_timer(self.query_timer)
@@ -545,10 +630,11 @@ class QueryStatusHelper:
         cconn = web_request.get_client_connection()
         template = web_request.get_dict('response_template', {})
         if is_subscribe and cconn in self.clients:
-            del self.clients[cconn]
+            self.clients.pop(cconn).clients.remove(cconn)
         reactor = self.printer.get_reactor()
         complete = reactor.completion()
-        self.pending_queries.append((None, objects, complete.complete, {}))
+        self.pending_queries.append((None, dict(objects), complete.complete,
+                                     {}))
         # Start timer if needed
         if self.query_timer is None:
             qt = reactor.register_timer(self._do_query, reactor.NOW)
@@ -557,7 +643,16 @@ class QueryStatusHelper:
         msg = complete.wait()
         web_request.send(msg['params'])
         if is_subscribe:
-            self.clients[cconn] = (cconn, objects, cconn.send, template)
+            self._add_subscription(cconn, objects, template)
+    def _add_subscription(self, cconn, objects, template):
+        for sub in self.subscriptions:
+            if sub.matches(objects, template):
+                break
+        else:
+            sub = StatusSubscription(objects, template)
+            self.subscriptions.append(sub)
+        sub.clients.append(cconn)
+        self.clients[cconn] = sub
     def _handle_subscribe(self, web_request):
         self._handle_query(web_request, is_subscribe=True)
 
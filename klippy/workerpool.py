@@ -0,0 +1,125 @@
+# Run cpu intensive calculations in background processes
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import logging, collections, multiprocessing, traceback
+import queuelogger
+
+REPORT_TIME = 5.
+
+class WorkerError(Exception):
+    pass
+
+# Code run in the background process
+def _worker_main(conn, func, args):
+    queuelogger.clear_bg_logging()
+    try:
+        res = (None, func(*args))
+    except Exception as e:
+        res = (e, traceback.format_exc())
+    try:
+        conn.send(res)
+    except Exception as e:
+        # Result (or exception) could not be transferred
+        conn.send((WorkerError("Unable to transfer result: %s" % (e,)),
+                   traceback.format_exc()))
+    conn.close()
+
+# Tracking of a single background calculation
+class WorkerJob:
+    def __init__(self, pool, func, args):
+        self.pool = pool
+        self.func = func
+        self.args = args
+        self.completion = pool.reactor.completion()
+        self.process = self.conn = self.fd_handle = None
+    def start(self):
+        self.conn, child_conn = multiprocessing.Pipe(False)
+        self.process = multiprocessing.Process(
+            target=_worker_main, args=(child_conn, self.func, self.args))
+        self.process.daemon = True
+        self.process.start()
+        child_conn.close()
+        self.func = self.args = None
+        self.fd_handle = self.pool.reactor.register_fd(self.conn.fileno(),
+                                                       self._handle_ready)
+    def _handle_ready(self, eventtime):
+        self.pool.reactor.unregister_fd(self.fd_handle)
+        try:
+            res = self.conn.recv()
+        except (EOFError, OSError):
+            res = (WorkerError("Background process exited unexpectedly"), "")
+        except Exception as e:
+            # Result could not be decoded (eg, an unpickling error)
+            res = (WorkerError("Unable to read result: %s" % (e,)),
+                   traceback.format_exc())
+        self.conn.close()
+        self.process.join()
+        self.pool.note_job_done(self)
+        self.completion.complete(res)
+    def terminate(self):
+        self.process.terminate()
+
+# Pool of background processes (each job is run in a forked process so
+# that it can use any function and arguments - including closures)
+class WorkerPool:
+    def __init__(self, printer, max_workers=None):
+        self.printer = printer
+        self.reactor = printer.get_reactor()
+        if max_workers is None:
+            # Leave one cpu for the main klippy process
+            max_workers = max(1, multiprocessing.cpu_count() - 1)
+        self.max_workers = max_workers
+        self.pending = collections.deque()
+        self.active = []
+        printer.register_event_handler("klippy:disconnect",
+                                       self._handle_disconnect)
+    def _handle_disconnect(self):
+        self.pending.clear()
+        for job in self.active:
+            job.terminate()
+    def _start_jobs(self):
+        while self.pending and len(self.active) < self.max_workers:
+            job = self.pending.popleft()
+            try:
+                job.start()
+            except OSError as e:
+                logging.exception("Unable to start background process")
+                job.completion.complete((WorkerError(str(e)), ""))
+                continue
+            self.active.append(job)
+    def note_job_done(self, job):
+        self.active.remove(job)
+        self._start_jobs()
+    # Start a calculation - the returned completion is completed with
+    # an (exception, traceback) or (None, result) tuple
+    def submit(self, func, args=()):
+        job = WorkerJob(self, func, args)
+        self.pending.append(job)
+        self._start_jobs()
+        return job.completion
+    # Wait for a submitted calculation and return its result (or raise
+    # the exception raised by the calculation)
+    def wait(self, completion, wait_msg=None):
+        gcode = self.printer.lookup_object("gcode")
+        while 1:
+            res = completion.wait(self.reactor.monotonic() + REPORT_TIME)
+            if res is not None:
+                break
+            if wait_msg is not None:
+                gcode.respond_info(wait_msg, log=False)
+        err, val = res
+        if err is not None:
+            logging.info("Error in background calculation:\n%s", val)
+            raise err
+        return val
+    def run(self, func, args=(), wait_msg=None):
+        return self.wait(self.submit(func, args), wait_msg)
+
+def get_worker_pool(printer):
+    pool = printer.lookup_object('worker_pool', None)
+    if pool is None:
+        pool = WorkerPool(printer)
+        printer.add_object('worker_pool', pool)
+    return pool
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+# Benchmark of host memory allocations for g-code moves and mcu messages
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, optparse, time, gc, tracemalloc, json
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+import reactor, gcode, toolhead, msgproto
+
+# Minimal printer object needed by the g-code dispatcher
+class BenchPrinter:
+    def __init__(self):
+        self.reactor = reactor.Reactor()
+    def get_reactor(self):
+        return self.reactor
+    def get_start_args(self):
+        return {}
+    def register_event_handler(self, event, callback):
+        pass
+
+# Minimal toolhead settings needed to create and plan Move objects
+class BenchToolhead:
+    max_accel = 3000.
+    max_velocity = 300.
+    junction_deviation = 0.013
+    mcr_pseudo_accel = 1500.
+    extra_axes = []
+
+# Measure the cpu time of running a benchmark and the allocations
+# that remain live afterwards (the benchmark should retain any objects
+# it creates, as the host code would while they are queued)
+def measure(setup, count):
+    func = setup(count)
+    gc.collect()
+    start_time = time.process_time()
+    func(count)
+    cpu_time = time.process_time() - start_time
+    func = setup(count)
+    gc.collect()
+    gc.disable()
+    tracemalloc.start()
+    snap_before = tracemalloc.take_snapshot()
+    objs_before = len(gc.get_objects())
+    func(count)
+    objs_after = len(gc.get_objects())
+    snap_after = tracemalloc.take_snapshot()
+    tracemalloc.stop()
+    gc.enable()
+    stats = snap_after.compare_to(snap_before, 'filename')
+    blocks = sum([s.count_diff for s in stats])
+    size = sum([s.size_diff for s in stats])
+    return {'count': count,
+            'blocks_per_item': float(blocks) / count,
+            'bytes_per_item': float(size) / count,
+            'gc_objects_per_item': float(objs_after - objs_before) / count,
+            'usec_per_item': cpu_time * 1000000. / count}
+
+# Process "G1" commands through the g-code dispatcher and create a
+# Move object for each (the Move objects are retained, as they would be
+# in the toolhead look-ahead queue)
+def bench_moves(count):
+    printer = BenchPrinter()
+    gcode_dispatch = gcode.GCodeDispatch(printer)
+    th = BenchToolhead()
+    moves = []
+    last_pos = [0., 0., 0., 0.]
+    def cmd_G1(gcmd):
+        params = gcmd.get_command_parameters()
+        pos = list(last_pos)
+        for i, axis in enumerate('XYZE'):
+            if axis in params:
+                pos[i] = float(params[axis])
+        speed = gcmd.get_float('F', 6000., above=0.) / 60.
+        move = toolhead.Move(th, last_pos, pos, speed)
+        if moves:
+            move.calc_junction(moves[-1])
+        moves.append(move)
+        last_pos[:] = pos
+    gcode_dispatch.register_command('G1', cmd_G1, when_not_ready=True)
+    lines = ["G1 X%.3f Y%.3f E%.5f F6000" % (
+                 100. + (i % 50), 100. + (i % 2) * 20., i * .02)
+             for i in range(count)]
+    def run(count):
+        # Process in blocks, similar to the g-code input handler
+        for i in range(0, count, 100):
+            gcode_dispatch._process_commands(lines[i:i+100])
+    return run
+
+# Parse mcu response messages (the results are retained, as they
+# would be in a bulk data queue)
+RESPONSES = {
+    "clock clock=%u": 81,
+    "stepper_position oid=%c pos=%i": 82,
+    "analog_in_state oid=%c next_clock=%u value=%hu": 83,
+    "sensor_bulk_data oid=%c sequence=%hu data=%*s": 84,
+}
+def bench_messages(count):
+    parser = msgproto.MessageParser()
+    parser.process_identify(json.dumps({
+        'commands': {}, 'responses': RESPONSES}).encode(), decompress=False)
+    samples = [
+        (81, [123456789]),
+        (82, [3, -2000]),
+        (83, [5, 987654321, 12345]),
+        (84, [7, 1234, b'\x01\x02\x03\x04' * 12]),
+    ]
+    blocks = []
+    for msgid, params in samples:
+        cmd = parser.messages_by_id[msgid].encode(params)
+        msg = [len(cmd) + msgproto.MESSAGE_MIN, msgproto.MESSAGE_DEST] + cmd
+        msg += msgproto.crc16_ccitt(msg) + [msgproto.MESSAGE_SYNC]
+        blocks.append(bytes(bytearray(msg)))
+    msgs = [blocks[i % len(blocks)] for i in range(count)]
+    def run(count):
+        parse = parser.parse
+        out = [parse(msg) for msg in msgs]
+        msgs[:] = out
+    return run
+
+def main():
+    usage = "%prog [options]"
+    opts = optparse.OptionParser(usage)
+    opts.add_option("-n", "--count", dest="count", type="int", default=20000,
+                    help="number of moves and messages (default 20000)")
+    opts.add_option("-j", "--json", dest="json",
+                    help="write json results to file ('-' for stdout)")
+    options, args = opts.parse_args()
+    if args:
+        opts.error("Incorrect number of arguments")
+    count = options.count
+    result = {'python': sys.version.split()[0],
+              'moves': measure(bench_moves, count),
+              'messages': measure(bench_messages, count)}
+    if options.json is not None:
+        data = json.dumps(result, indent=2, sort_keys=True)
+        if options.json == '-':
+            sys.stdout.write(data + "\n")
+        else:
+            f = open(options.json, 'w')
+            f.write(data + "\n")
+            f.close()
+        return
+    out = []
+    for name in ['moves', 'messages']:
+        r = result[name]
+        out.append("%s: count=%d blocks/item=%.1f bytes/item=%.1f"
+                   " gc_objects/item=%.2f usec/item=%.2f" % (
+                       name, r['count'], r['blocks_per_item'],
+                       r['bytes_per_item'], r['gc_objects_per_item'],
+                       r['usec_per_item']))
+    sys.stdout.write("\n".join(out) + "\n")
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+# Host motion planning benchmark using the klippy batch mode
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, optparse, logging, time, json, gc, resource, tempfile
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+import greenlet
+import util, reactor, msgproto, klippy, gcode, toolhead
+import kinematics.extruder
+from extras import gcode_move, motion_queuing
+
+
+######################################################################
+# Per-stage timing
+######################################################################
+
+# Stages are reported with "exclusive" time - time spent in a nested
+# stage is only charged to that nested stage.
+STAGES = [
+    ("gcode", gcode.GCodeDispatch, "_process_commands"),
+    ("gcode_move", gcode_move.GCodeMove, "cmd_G1"),
+    ("toolhead", toolhead.ToolHead, "move"),
+    ("lookahead", toolhead.LookAheadQueue, "flush"),
+    ("trapq", toolhead.ToolHead, "_process_lookahead"),
+    ("extruder", kinematics.extruder.PrinterExtruder, "process_moves"),
+    ("step_generation", motion_queuing.PrinterMotionQueuing,
+     "_advance_flush_time"),
+]
+
+class StageTimer:
+    def __init__(self):
+        self.cpu = {}
+        self.wall = {}
+        self.calls = {}
+        self.stacks = {}
+        self.moves = 0
+    def _wrap(self, name, cls, method):
+        orig = getattr(cls, method)
+        self.cpu[name] = self.wall[name] = 0.
+        self.calls[name] = 0
+        enter, leave = self._enter, self._leave
+        def wrapper(*args, **kwargs):
+            enter()
+            try:
+                return orig(*args, **kwargs)
+            finally:
+                leave(name)
+        setattr(cls, method, wrapper)
+    def install(self):
+        for name, cls, method in STAGES:
+            self._wrap(name, cls, method)
+        # Count moves leaving the lookahead queue
+        orig_flush = toolhead.LookAheadQueue.flush
+        def flush(lq, *args, **kwargs):
+            res = orig_flush(lq, *args, **kwargs)
+            self.moves += len(res)
+            return res
+        toolhead.LookAheadQueue.flush = flush
+    def _enter(self):
+        # Stage stacks are tracked per greenlet as a stage may pause
+        stack = self.stacks.setdefault(greenlet.getcurrent(), [])
+        stack.append([time.process_time(), time.time(), 0., 0.])
+    def _leave(self, name):
+        stack = self.stacks[greenlet.getcurrent()]
+        start_cpu, start_wall, child_cpu, child_wall = stack.pop()
+        cpu = time.process_time() - start_cpu
+        wall = time.time() - start_wall
+        self.cpu[name] += cpu - child_cpu
+        self.wall[name] += wall - child_wall
+        self.calls[name] += 1
+        if stack:
+            stack[-1][2] += cpu
+            stack[-1][3] += wall
+
+
+######################################################################
+# Output analysis
+######################################################################
+
+def count_steps(dict_fname, data_fname):
+    f = open(dict_fname, 'rb')
+    dictionary = f.read()
+    f.close()
+    mp = msgproto.MessageParser()
+    mp.process_identify(dictionary, decompress=False)
+    queue_step = mp.messages_by_name.get('queue_step')
+    steps = msgs = 0
+    f = open(data_fname, 'rb')
+    data = bytearray(f.read())
+    f.close()
+    pos = 0
+    while pos < len(data):
+        l = mp.check_packet(data[pos:pos+msgproto.MESSAGE_MAX])
+        if l <= 0:
+            if not l:
+                break
+            pos += -l
+            continue
+        block = data[pos:pos+l]
+        mpos = msgproto.MESSAGE_HEADER_SIZE
+        while mpos < l - msgproto.MESSAGE_TRAILER_SIZE:
+            msgid, param_pos = mp.msgid_parser.parse(block, mpos)
+            mid = mp.messages_by_id.get(msgid, mp.unknown)
+            params, mpos = mid.parse(block, mpos)
+            msgs += 1
+            if mid is queue_step:
+                steps += params['count']
+        pos += l
+    return steps, msgs
+
+
+######################################################################
+# Startup
+######################################################################
+
+def run_klippy(start_args):
+    gc.disable()
+    gc.collect()
+    main_reactor = reactor.Reactor(gc_checking=True)
+    printer = klippy.Printer(main_reactor, None, start_args)
+    res = printer.run()
+    main_reactor.finalize()
+    return res
+
+def main():
+    usage = "%prog [options] <config file> <gcode file>"
+    opts = optparse.OptionParser(usage)
+    opts.add_option("-d", "--dictionary", dest="dictionary", type="string",
+                    action="callback", callback=klippy.arg_dictionary,
+                    help="file to read for mcu protocol dictionary")
+    opts.add_option("-o", "--output", dest="output",
+                    help="write mcu output to file (default is a temp file)")
+    opts.add_option("-j", "--json", dest="json",
+                    help="write json results to file ('-' for stdout)")
+    opts.add_option("-v", action="store_true", dest="verbose",
+                    help="enable klippy log messages")
+    options, args = opts.parse_args()
+    if len(args) != 2:
+        opts.error("Incorrect number of arguments")
+    if options.dictionary is None:
+        opts.error("A data dictionary must be specified")
+    config_fname, gcode_fname = args
+    logging.basicConfig(level=logging.WARNING)
+    if options.verbose:
+        logging.getLogger().setLevel(logging.INFO)
+    # Setup klippy batch mode arguments
+    tempdir = None
+    out_fname = options.output
+    if out_fname is None:
+        tempdir = tempfile.mkdtemp(prefix="bench_klippy")
+        out_fname = os.path.join(tempdir, "output")
+    debuginput = open(gcode_fname, 'rb')
+    start_args = {'config_file': config_fname, 'apiserver': None,
+                  'start_reason': 'startup', 'debuginput': gcode_fname,
+                  'gcode_fd': debuginput.fileno(), 'debugoutput': out_fname,
+                  'software_version': '?', 'cpu_info': util.get_cpu_info(),
+                  'device': '?', 'linux_version': '?'}
+    start_args.update(options.dictionary)
+    # Run klippy with stage instrumentation
+    stages = StageTimer()
+    stages.install()
+    start_cpu, start_wall = time.process_time(), time.time()
+    res = run_klippy(start_args)
+    total_cpu = time.process_time() - start_cpu
+    total_wall = time.time() - start_wall
+    debuginput.close()
+    peak_rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if res != 'exit':
+        sys.stderr.write("Klippy did not complete successfully (%s)\n"
+                         % (res,))
+        sys.exit(-1)
+    # Count generated steps in each mcu output file
+    steps = msgs = 0
+    for key, dict_fname in options.dictionary.items():
+        fname = out_fname
+        if key != 'dictionary':
+            fname = out_fname + "-" + key[len('dictionary_'):]
+        s, m = count_steps(dict_fname, fname)
+        steps += s
+        msgs += m
+        if tempdir is not None:
+            os.unlink(fname)
+    if tempdir is not None:
+        os.rmdir(tempdir)
+    # Report results
+    stage_cpu = sum(stages.cpu.values())
+    stage_wall = sum(stages.wall.values())
+    result = {
+        'config': config_fname, 'gcode': gcode_fname,
+        'cpu_info': start_args['cpu_info'],
+        'python': sys.version.split()[0],
+        'wall_time': total_wall, 'cpu_time': total_cpu,
+        'moves': stages.moves, 'steps': steps, 'mcu_messages': msgs,
+        'moves_per_second': stages.moves / total_wall,
+        'steps_per_second': steps / total_wall,
+        'peak_rss_kb': peak_rss,
+        'stages': {name: {'cpu_time': stages.cpu[name],
+                          'wall_time': stages.wall[name],
+                          'calls': stages.calls[name]}
+                   for name, cls, method in STAGES},
+    }
+    result['stages']['other'] = {'cpu_time': total_cpu - stage_cpu,
+                                 'wall_time': total_wall - stage_wall,
+                                 'calls': 0}
+    if options.json is not None:
+        data = json.dumps(result, indent=2, sort_keys=True)
+        if options.json == '-':
+            sys.stdout.write(data + "\n")
+        else:
+            f = open(options.json, 'w')
+            f.write(data + "\n")
+            f.close()
+        return
+    out = ["moves=%d (%.0f/s) steps=%d (%.0f/s) mcu_messages=%d" % (
+               stages.moves, result['moves_per_second'],
+               steps, result['steps_per_second'], msgs),
+           "wall_time=%.3f cpu_time=%.3f peak_rss=%dKiB" % (
+               total_wall, total_cpu, peak_rss),
+           "%-16s %10s %10s %9s" % ("stage", "cpu", "wall", "calls")]
+    for name in [s[0] for s in STAGES] + ['other']:
+        st = result['stages'][name]
+        out.append("%-16s %10.3f %10.3f %9d" % (
+            name, st['cpu_time'], st['wall_time'], st['calls']))
+    sys.stdout.write("\n".join(out) + "\n")
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+# Benchmark of the klippy reactor timer dispatch
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, optparse, time, json
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+import reactor
+
+# Update periods of the background timers (similar to the periods of
+# heater, fan, sensor, and status timers in a typical config)
+TIMER_PERIODS = [0.100, 0.250, 0.300, 0.500, 1.000, 2.000]
+
+class TimerLoad:
+    def __init__(self, reactor, timer_count, idle_count, flush_period):
+        self.reactor = reactor
+        self.callbacks = 0
+        self.timers = []
+        for i in range(timer_count):
+            period = TIMER_PERIODS[i % len(TIMER_PERIODS)]
+            waketime = reactor.NEVER
+            if i >= idle_count:
+                waketime = period * (i + 1) / timer_count
+            cb = (lambda e, p=period: self._background(e, p))
+            self.timers.append(reactor.register_timer(cb, waketime))
+        # Timer that simulates the motion flush timer
+        self.flush_period = flush_period
+        self.flush_waketime = flush_period
+        self.flush_delays = []
+        self.flush_timer = reactor.register_timer(self._flush,
+                                                  self.flush_waketime)
+    def _background(self, eventtime, period):
+        self.callbacks += 1
+        return eventtime + period
+    def _flush(self, eventtime):
+        self.callbacks += 1
+        self.flush_delays.append(self.reactor.monotonic()
+                                 - self.flush_waketime)
+        self.flush_waketime += self.flush_period
+        return self.flush_waketime
+    def start(self, start_time):
+        # Shift all timers to start at the given time
+        r = self.reactor
+        for t in self.timers:
+            if t.waketime != r.NEVER:
+                r.update_timer(t, t.waketime + start_time)
+        self.flush_waketime += start_time
+        r.update_timer(self.flush_timer, self.flush_waketime)
+
+# Run the timer dispatch code directly using a simulated clock
+def bench_dispatch(options):
+    r = reactor.Reactor()
+    if options.profile:
+        r.setup_profiler()
+    clock = [0.]
+    r.monotonic = (lambda: clock[0])
+    load = TimerLoad(r, options.timers, options.idle, options.flush)
+    load.start(0.)
+    end_time = options.duration
+    wakeups = 0
+    start_cpu = time.process_time()
+    while clock[0] < end_time:
+        clock[0] = eventtime = max(clock[0], r._next_timer)
+        r._check_timers(eventtime, False)
+        wakeups += 1
+    cpu_time = time.process_time() - start_cpu
+    return {'wakeups': wakeups, 'callbacks': load.callbacks,
+            'cpu_time': cpu_time,
+            'usec_per_wakeup': cpu_time * 1000000. / wakeups,
+            'usec_per_callback': cpu_time * 1000000. / load.callbacks}
+
+# Run the reactor in real time and measure the flush timer latency
+def bench_live(options):
+    r = reactor.Reactor()
+    if options.profile:
+        r.setup_profiler()
+    load = TimerLoad(r, options.timers, options.idle, options.flush)
+    load.start(r.monotonic() + .100)
+    def end_cb(eventtime):
+        r.end()
+        return r.NEVER
+    r.register_timer(end_cb, r.monotonic() + .100 + options.live)
+    start_cpu = time.process_time()
+    r.run()
+    cpu_time = time.process_time() - start_cpu
+    r.finalize()
+    delays = sorted(load.flush_delays)
+    if not delays:
+        return {}
+    count = len(delays)
+    return {'callbacks': load.callbacks, 'cpu_time': cpu_time,
+            'flush_count': count,
+            'flush_delay_avg': sum(delays) / count,
+            'flush_delay_p99': delays[min(count - 1, int(count * .99))],
+            'flush_delay_max': delays[-1]}
+
+def main():
+    usage = "%prog [options]"
+    opts = optparse.OptionParser(usage)
+    opts.add_option("-n", "--timers", dest="timers", type="int", default=120,
+                    help="number of background timers (default 120)")
+    opts.add_option("-i", "--idle", dest="idle", type="int", default=40,
+                    help="number of background timers that are never"
+                    " scheduled (default 40)")
+    opts.add_option("-f", "--flush", dest="flush", type="float",
+                    default=0.005, help="flush timer period (default 0.005)")
+    opts.add_option("-d", "--duration", dest="duration", type="float",
+                    default=600., help="simulated seconds of timer"
+                    " dispatch (default 600)")
+    opts.add_option("-l", "--live", dest="live", type="float", default=5.,
+                    help="seconds to run the reactor in real time to"
+                    " measure flush timer latency (default 5, 0 to disable)")
+    opts.add_option("-p", "--profile", action="store_true", dest="profile",
+                    help="enable reactor callback profiling")
+    opts.add_option("-j", "--json", dest="json",
+                    help="write json results to file ('-' for stdout)")
+    options, args = opts.parse_args()
+    if args:
+        opts.error("Incorrect number of arguments")
+    if options.idle > options.timers:
+        opts.error("The number of idle timers exceeds the number of timers")
+    result = {'timers': options.timers, 'idle_timers': options.idle,
+              'flush_period': options.flush, 'profile': bool(options.profile),
+              'python': sys.version.split()[0],
+              'dispatch': bench_dispatch(options)}
+    if options.live > 0.:
+        result['live'] = bench_live(options)
+    if options.json is not None:
+        data = json.dumps(result, indent=2, sort_keys=True)
+        if options.json == '-':
+            sys.stdout.write(data + "\n")
+        else:
+            f = open(options.json, 'w')
+            f.write(data + "\n")
+            f.close()
+        return
+    d = result['dispatch']
+    out = ["timers=%d (idle=%d) flush_period=%.3f" % (
+               options.timers, options.idle, options.flush),
+           "dispatch: wakeups=%d callbacks=%d cpu_time=%.3f"
+           " usec/wakeup=%.2f usec/callback=%.2f" % (
+               d['wakeups'], d['callbacks'], d['cpu_time'],
+               d['usec_per_wakeup'], d['usec_per_callback'])]
+    live = result.get('live')
+    if live:
+        out.append("live: callbacks=%d cpu_time=%.3f flush_delay"
+                   " avg=%.6f p99=%.6f max=%.6f" % (
+                       live['callbacks'], live['cpu_time'],
+                       live['flush_delay_avg'], live['flush_delay_p99'],
+                       live['flush_delay_max']))
+    sys.stdout.write("\n".join(out) + "\n")
+
+if __name__ == '__main__':
+    main()
@@ -247,6 +247,9 @@ Handlers.append(Handle_arm_irq())
 ######################################################################
 
 # Dynamic command and response registration
+
+HF_FAST_PARSE = 0x02 # Must match src/command.h
+
 class HandleCommandGeneration:
     def __init__(self):
         self.commands = {}
@@ -430,6 +433,38 @@ const struct command_parser command_index[] PROGMEM = {
 const uint16_t command_index_size PROGMEM = ARRAY_SIZE(command_index);
 """
         return fmt % (externs, index)
+    def generate_fast_dispatch_code(self):
+        cases = []
+        max_params = 0
+        for msgname, (funcname, flags, _) in sorted(self.commands.items()):
+            if not int(flags, 0) & HF_FAST_PARSE:
+                continue
+            msg = self.messages_by_name[msgname]
+            param_types = [t for name, t in msgproto.lookup_params(msg)]
+            if not all([t.is_int for t in param_types]):
+                error("Command '%s' has non-integer parameters" % (msgname,))
+            max_params = max(max_params, len(param_types))
+            parse = ["        if (p > maxend)\n"
+                     "            command_parse_error();\n"
+                     "        args[%d] = command_parse_int(&p);\n" % (i,)
+                     for i in range(len(param_types))]
+            cases.append("    case %d: // %s\n%s"
+                         "        irq_poll();\n"
+                         "        %s(args);\n"
+                         "        return p;\n" % (
+                             self.msg_to_encid[msg], msg, "".join(parse),
+                             funcname))
+        fmt = """
+uint8_t *
+ctr_dispatch_fast(uint_fast16_t cmdid, uint8_t *p, uint8_t *maxend)
+{
+    uint32_t args[%d];
+    switch (cmdid) {
+%s    }
+    return NULL;
+}
+"""
+        return fmt % (max(max_params, 1), "".join(cases))
     def generate_param_code(self):
         sorted_param_types = sorted(
             [(i, a) for a, i in self.all_param_types.items()])
@@ -445,8 +480,9 @@ const uint16_t command_index_size PROGMEM = ARRAY_SIZE(command_index);
         self.create_message_ids()
         parsercode = self.generate_responses_code()
         cmdcode = self.generate_commands_code()
+        fastcode = self.generate_fast_dispatch_code()
         paramcode = self.generate_param_code()
-        return paramcode + parsercode + cmdcode
+        return paramcode + parsercode + cmdcode + fastcode
 
 Handlers.append(HandleCommandGeneration())
 
@@ -59,6 +59,9 @@ for TARGET in test/configs/*.config ; do
     ./scripts/check-software-div.sh .config out/*.elf
     finish_test mcu_compile "$TARGET"
     cp out/klipper.dict ${DICTDIR}/$(basename ${TARGET} .config).dict
+    if [ "$(basename ${TARGET})" = "hostsimulator.config" ]; then
+        cp out/klipper.elf ${BUILD_DIR}/hostsimulator.elf
+    fi
 done
 
 
@@ -81,3 +84,7 @@ finish_test klippy "Test invoke klippy (Python3)"
 start_test klippy "Test invoke klippy (Python2)"
 $PYTHON2 scripts/test_klippy.py -d ${DICTDIR} test/klippy/*.test
 finish_test klippy "Test invoke klippy (Python2)"
+
+start_test klippy "Test mcu simulator stepping (Python3)"
+$PYTHON scripts/mcu_simulator.py -n 2 --check --positions xy -c test/klippy/mcu_simulator.cfg -g test/klippy/mcu_simulator.gcode ${BUILD_DIR}/hostsimulator.elf
+finish_test klippy "Test mcu simulator stepping (Python3)"
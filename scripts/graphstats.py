@@ -4,8 +4,11 @@
 # Copyright (C) 2016-2025  Kevin O'Connor <kevin@koconnor.net>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
-import optparse, datetime
+import sys, os, optparse, datetime
 import matplotlib
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+import queuelogger
 
 MAXBANDWIDTH=25000.
 MAXBUFFER=1.
@@ -23,9 +26,9 @@ def parse_log(logname, mcu):
         mcu = "mcu"
     mcu_prefix = mcu + ":"
     apply_prefix = { p: 1 for p in APPLY_PREFIX }
-    f = open(logname, 'r')
+    f = open(logname, 'rb')
     out = []
-    for line in f:
+    for line in queuelogger.read_log_lines(f):
         parts = line.split()
         if not parts or parts[0] not in ('Stats', 'INFO:root:Stats'):
             #if parts and parts[0] == 'INFO:root:shutdown:':
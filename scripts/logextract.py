@@ -4,7 +4,10 @@
 # Copyright (C) 2017  Kevin O'Connor <kevin@koconnor.net>
 #
 # This file may be distributed under the terms of the GNU GPLv3 license.
-import sys, re, collections, ast, itertools
+import sys, os, re, collections, ast, itertools
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+import queuelogger
 
 def format_comment(line_num, line):
     return "# %6d: %s" % (line_num, line)
@@ -583,8 +586,8 @@ def main():
     handler = None
     recent_lines = collections.deque([], 200)
     # Parse log file
-    with open(logname, 'rt') as f:
-        for line_num, line in enumerate(f):
+    with open(logname, 'rb') as f:
+        for line_num, line in enumerate(queuelogger.read_log_lines(f)):
             line = line.rstrip()
             line_num += 1
             recent_lines.append((line_num, line))
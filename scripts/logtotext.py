@@ -0,0 +1,29 @@
+#!/usr/bin/env python3
+# Convert a binary klippy.log file to text
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, optparse
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+import queuelogger
+
+def main():
+    usage = "%prog [options] <logfile>"
+    opts = optparse.OptionParser(usage)
+    opts.add_option("-o", "--output", type="string", dest="output",
+                    default=None, help="filename of output text")
+    options, args = opts.parse_args()
+    if len(args) != 1:
+        opts.error("Incorrect number of arguments")
+    with open(args[0], 'rb') as f:
+        lines = queuelogger.read_log_lines(f)
+        if options.output is None:
+            sys.stdout.writelines(lines)
+            return
+        with open(options.output, 'w') as outf:
+            outf.writelines(lines)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,432 @@
+#!/usr/bin/env python3
+# Run simulated micro-controllers behind a modeled serial link
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, optparse, socket, select, subprocess, threading, fcntl, tty
+import collections, random, errno, json, time, signal
+
+# Set a file-descriptor as non-blocking
+def set_nonblock(fd):
+    fcntl.fcntl(fd, fcntl.F_SETFL
+                , fcntl.fcntl(fd, fcntl.F_GETFL) | os.O_NONBLOCK)
+
+
+######################################################################
+# Serial link model
+######################################################################
+
+class LinkModel:
+    def __init__(self, baud, latency, jitter, loss, seed):
+        # Each byte on a serial line takes 10 bits (start, 8 data, stop)
+        self.byte_time = 10. / baud if baud else 0.
+        self.latency = latency
+        self.jitter = jitter
+        self.loss = loss
+        self.rand = random.Random(seed)
+
+# Data flowing in one direction of a simulated serial link
+class LinkDirection:
+    def __init__(self, model, out_fd):
+        self.model = model
+        self.out_fd = out_fd
+        self.pending = collections.deque()
+        self.line_free_time = self.last_deliver_time = 0.
+        self.bytes_sent = self.bytes_dropped = 0
+    def add_data(self, eventtime, data):
+        model = self.model
+        # Serialize the data at the configured baud rate
+        start_time = max(eventtime, self.line_free_time)
+        self.line_free_time = start_time + len(data) * model.byte_time
+        deliver_time = self.line_free_time + model.latency
+        if model.jitter:
+            deliver_time += model.rand.uniform(0., model.jitter)
+        # Data on a serial line is never reordered
+        deliver_time = max(deliver_time, self.last_deliver_time)
+        self.last_deliver_time = deliver_time
+        if model.loss:
+            rand = model.rand.random
+            kept = bytes(bytearray([b for b in bytearray(data)
+                                    if rand() >= model.loss]))
+            self.bytes_dropped += len(data) - len(kept)
+            data = kept
+        self.pending.append([deliver_time, data])
+    def next_time(self):
+        if not self.pending:
+            return None
+        return self.pending[0][0]
+    def flush(self, eventtime):
+        pending = self.pending
+        while pending and pending[0][0] <= eventtime:
+            data = pending[0][1]
+            try:
+                count = os.write(self.out_fd, data) if data else 0
+            except OSError as e:
+                if e.errno != errno.EAGAIN:
+                    raise
+                count = 0
+            self.bytes_sent += count
+            if count < len(data):
+                # Output blocked - retry on next flush
+                pending[0][1] = data[count:]
+                return
+            pending.popleft()
+    def get_stats(self):
+        return {'bytes': self.bytes_sent, 'dropped': self.bytes_dropped}
+
+# A simulator firmware process with a pseudo-tty for the host
+class SimulatedMCU:
+    def __init__(self, elf, ptyname, model, logname):
+        self.ptyname = ptyname
+        host_sock, mcu_sock = socket.socketpair()
+        logfile = open(logname, 'wb')
+        self.proc = subprocess.Popen([elf], stdin=mcu_sock, stdout=mcu_sock,
+                                     stderr=logfile)
+        mcu_sock.close()
+        logfile.close()
+        self.host_sock = host_sock
+        set_nonblock(host_sock.fileno())
+        # Create pseudo-tty (the slave is held open so that the master
+        # does not report errors while the host is disconnected)
+        self.master_fd, self.slave_fd = os.openpty()
+        tty.setraw(self.slave_fd)
+        set_nonblock(self.master_fd)
+        try:
+            os.unlink(ptyname)
+        except OSError:
+            pass
+        os.symlink(os.ttyname(self.slave_fd), ptyname)
+        self.to_mcu = LinkDirection(model, host_sock.fileno())
+        self.to_host = LinkDirection(model, self.master_fd)
+        self.inputs = {self.master_fd: self.to_mcu,
+                       host_sock.fileno(): self.to_host}
+    def get_stats(self):
+        return {'to_mcu': self.to_mcu.get_stats(),
+                'to_host': self.to_host.get_stats()}
+    def close(self):
+        self.proc.terminate()
+        self.proc.wait()
+        try:
+            os.unlink(self.ptyname)
+        except OSError:
+            pass
+        self.host_sock.close()
+        os.close(self.master_fd)
+        os.close(self.slave_fd)
+
+# Background thread that passes data over the simulated links
+class LinkSimulator:
+    def __init__(self, mcus):
+        self.mcus = mcus
+        self.inputs = {}
+        self.directions = []
+        for m in mcus:
+            self.inputs.update(m.inputs)
+            self.directions.extend([m.to_mcu, m.to_host])
+        self.must_stop = False
+        self.thread = threading.Thread(target=self._run)
+        self.thread.daemon = True
+    def start(self):
+        self.thread.start()
+    def stop(self):
+        self.must_stop = True
+        self.thread.join()
+    def _run(self):
+        poll = select.poll()
+        for fd in self.inputs:
+            poll.register(fd, select.POLLIN)
+        while not self.must_stop:
+            eventtime = time.monotonic()
+            timeout = 0.100
+            for d in self.directions:
+                next_time = d.next_time()
+                if next_time is not None:
+                    timeout = min(timeout, max(0., next_time - eventtime))
+            res = poll.poll(int(timeout * 1000. + .999))
+            eventtime = time.monotonic()
+            for fd, event in res:
+                try:
+                    data = os.read(fd, 4096)
+                except OSError as e:
+                    # EIO is reported on a pty when the host disconnects
+                    if e.errno not in (errno.EAGAIN, errno.EIO):
+                        raise
+                    continue
+                if data:
+                    self.inputs[fd].add_data(eventtime, data)
+            for d in self.directions:
+                d.flush(eventtime)
+
+
+######################################################################
+# Klippy benchmark mode
+######################################################################
+
+class KlippyAPI:
+    def __init__(self, uds_filename, timeout):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        endtime = time.time() + timeout
+        while 1:
+            try:
+                self.sock.connect(uds_filename)
+                break
+            except socket.error:
+                if time.time() > endtime:
+                    raise
+                time.sleep(0.100)
+        self.data = b""
+        self.next_id = 1
+    def send(self, method, params={}):
+        req_id = self.next_id
+        self.next_id += 1
+        msg = {'id': req_id, 'method': method, 'params': params}
+        self.sock.sendall(json.dumps(msg).encode() + b'\x03')
+        while 1:
+            while b'\x03' not in self.data:
+                data = self.sock.recv(65536)
+                if not data:
+                    raise socket.error("Klippy closed the api socket")
+                self.data += data
+            line, self.data = self.data.split(b'\x03', 1)
+            resp = json.loads(line)
+            if resp.get('id') == req_id:
+                return resp
+    def close(self):
+        self.sock.close()
+
+# Collect the samples of a stepper position stream in a background thread
+class PositionMonitor:
+    def __init__(self, uds_filename, stream, timeout):
+        self.api = KlippyAPI(uds_filename, timeout)
+        resp = self.api.send("stepper_position/dump_positions",
+                             {'stream': stream, 'response_template': {}})
+        if 'error' in resp:
+            raise Exception("Unable to subscribe to position stream: %s"
+                            % (resp['error']['message'],))
+        self.header = resp['result']['header']
+        self.samples = []
+        self.errors = 0
+        self.thread = threading.Thread(target=self._run)
+        self.thread.daemon = True
+        self.thread.start()
+    def _run(self):
+        api = self.api
+        while 1:
+            while b'\x03' not in api.data:
+                try:
+                    data = api.sock.recv(65536)
+                except socket.error:
+                    return
+                if not data:
+                    return
+                api.data += data
+            line, api.data = api.data.split(b'\x03', 1)
+            params = json.loads(line).get('params', {})
+            self.samples.extend(params.get('data', []))
+            self.errors += params.get('errors', 0)
+    def close(self):
+        self.api.sock.shutdown(socket.SHUT_RDWR)
+        self.thread.join()
+        self.api.close()
+    # Compare the sampled positions with the commanded positions (a
+    # sample may be anywhere between the commanded positions of the
+    # previous and next sample to allow for sampling jitter)
+    def check(self):
+        samples = self.samples
+        if len(samples) < 3:
+            return ["No stepper positions were reported"]
+        errors = []
+        if self.errors:
+            errors.append("%d stepper position samples were lost"
+                          % (self.errors,))
+        for i in range(1, len(self.header), 2):
+            name = self.header[i]
+            positions = [s[i] for s in samples]
+            if min(positions) == max(positions):
+                errors.append("Stepper %s did not move" % (name,))
+            bad = 0
+            for j in range(1, len(samples) - 1):
+                cmd = [s[i+1] for s in samples[j-1:j+2]]
+                if positions[j] < min(cmd) or positions[j] > max(cmd):
+                    bad += 1
+            if positions[-1] != samples[-1][i+1]:
+                # The final (stationary) position must match exactly
+                bad += 1
+            if bad:
+                errors.append("Stepper %s position differs from commanded"
+                              " position in %d samples" % (name, bad))
+        return errors
+
+def wait_ready(api, timeout):
+    endtime = time.time() + timeout
+    while 1:
+        info = api.send("info").get('result', {})
+        state = info.get('state')
+        if state == 'ready':
+            return
+        if state in ('error', 'shutdown') or time.time() > endtime:
+            raise Exception("Klippy not ready (%s): %s"
+                            % (state, info.get('state_message', '').strip()))
+        time.sleep(0.250)
+
+def run_gcode(api, gcode_fname, lines_per_request):
+    f = open(gcode_fname, 'r')
+    lines = [l.strip() for l in f.readlines()]
+    f.close()
+    lines = [l for l in lines if l and not l.startswith(';')] + ["M400"]
+    for i in range(0, len(lines), lines_per_request):
+        script = "\n".join(lines[i:i+lines_per_request])
+        resp = api.send("gcode/script", {'script': script})
+        if 'error' in resp:
+            raise Exception("G-Code error: %s" % (resp['error']['message'],))
+
+def query_mcu_stats(api):
+    objs = api.send("objects/list")['result']['objects']
+    names = [n for n in objs if n == 'mcu' or n.startswith('mcu ')]
+    resp = api.send("objects/query",
+                    {'objects': {n: ['last_stats'] for n in names}})
+    status = resp['result']['status']
+    return {n: status[n].get('last_stats', {}) for n in names}
+
+# Verify that klippy is still ready and that each mcu received moves
+def check_results(api, mcu_stats):
+    errors = []
+    info = api.send("info").get('result', {})
+    if info.get('state') != 'ready':
+        errors.append("Klippy not ready (%s): %s" % (
+            info.get('state'), info.get('state_message', '').strip()))
+    for name, stats in sorted(mcu_stats.items()):
+        if not stats.get('movequeue_moves'):
+            errors.append("No moves were sent to %s" % (name,))
+    return errors
+
+REPORT_STATS = ['bytes_write', 'bytes_read', 'bytes_retransmit',
+                'bytes_invalid', 'srtt', 'rto', 'movequeue_stalls',
+                'movequeue_stall_time']
+
+def run_benchmark(options, mcus):
+    uds_filename = options.prefix + "_api"
+    klippy = os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                          '..', 'klippy', 'klippy.py')
+    logname = options.prefix + "_klippy.log"
+    proc = subprocess.Popen([sys.executable, klippy, options.config,
+                             '-a', uds_filename, '-l', logname])
+    try:
+        api = KlippyAPI(uds_filename, options.timeout)
+        wait_ready(api, options.timeout)
+        monitor = None
+        if options.positions is not None:
+            monitor = PositionMonitor(uds_filename, options.positions,
+                                      options.timeout)
+        start_time = time.time()
+        run_gcode(api, options.gcode, options.lines)
+        run_time = time.time() - start_time
+        # Wait for the periodic stats update
+        time.sleep(1.5)
+        mcu_stats = query_mcu_stats(api)
+        errors = []
+        if options.check:
+            errors = check_results(api, mcu_stats)
+        if monitor is not None:
+            monitor.close()
+            errors.extend(monitor.check())
+        api.close()
+    finally:
+        proc.send_signal(signal.SIGINT)
+        proc.wait()
+    result = {'config': options.config, 'gcode': options.gcode,
+              'wall_time': run_time, 'mcu_stats': mcu_stats,
+              'links': {m.ptyname: m.get_stats() for m in mcus}}
+    if errors:
+        sys.stderr.write("\n".join(errors) + "\n")
+        sys.exit(-1)
+    if options.json is not None:
+        data = json.dumps(result, indent=2, sort_keys=True)
+        if options.json == '-':
+            sys.stdout.write(data + "\n")
+        else:
+            f = open(options.json, 'w')
+            f.write(data + "\n")
+            f.close()
+        return
+    out = ["wall_time=%.3f" % (run_time,)]
+    for name, stats in sorted(mcu_stats.items()):
+        out.append("%s: %s" % (name, " ".join(
+            ["%s=%s" % (k, stats[k]) for k in REPORT_STATS if k in stats])))
+    for m in mcus:
+        st = m.get_stats()
+        out.append("%s: to_mcu=%d (dropped %d) to_host=%d (dropped %d)" % (
+            m.ptyname, st['to_mcu']['bytes'], st['to_mcu']['dropped'],
+            st['to_host']['bytes'], st['to_host']['dropped']))
+    sys.stdout.write("\n".join(out) + "\n")
+
+
+######################################################################
+# Startup
+######################################################################
+
+def main():
+    usage = "%prog [options] <simulator klipper.elf>"
+    opts = optparse.OptionParser(usage)
+    opts.add_option("-n", "--count", dest="count", type="int", default=1,
+                    help="number of micro-controllers to simulate")
+    opts.add_option("-p", "--prefix", dest="prefix",
+                    default="/tmp/klipper_sim",
+                    help="pseudo-tty name prefix (default /tmp/klipper_sim)")
+    opts.add_option("-b", "--baud", dest="baud", type="int", default=250000,
+                    help="serial baud rate to model (0 for unlimited)")
+    opts.add_option("--latency", dest="latency", type="float", default=0.,
+                    help="one way link latency (in seconds)")
+    opts.add_option("--jitter", dest="jitter", type="float", default=0.,
+                    help="maximum random additional latency (in seconds)")
+    opts.add_option("--loss", dest="loss", type="float", default=0.,
+                    help="probability that a transmitted byte is lost")
+    opts.add_option("--seed", dest="seed", type="int", default=0,
+                    help="random seed for the jitter and loss model")
+    opts.add_option("-c", "--config", dest="config",
+                    help="run klippy with this config (benchmark mode)")
+    opts.add_option("-g", "--gcode", dest="gcode",
+                    help="g-code file to run in benchmark mode")
+    opts.add_option("-l", "--lines", dest="lines", type="int", default=100,
+                    help="g-code lines per api request (default 100)")
+    opts.add_option("-t", "--timeout", dest="timeout", type="float",
+                    default=30., help="klippy startup timeout (in seconds)")
+    opts.add_option("--check", action="store_true", dest="check",
+                    help="exit with an error if klippy shuts down or an"
+                    " mcu receives no moves (for regression tests)")
+    opts.add_option("--positions", dest="positions",
+                    help="subscribe to this stepper_position_stream and"
+                    " verify the reported positions")
+    opts.add_option("-j", "--json", dest="json",
+                    help="write json results to file ('-' for stdout)")
+    options, args = opts.parse_args()
+    if len(args) != 1:
+        opts.error("Incorrect number of arguments")
+    if (options.config is None) != (options.gcode is None):
+        opts.error("Benchmark mode requires both a config and g-code file")
+    model = LinkModel(options.baud, options.latency, options.jitter,
+                      options.loss, options.seed)
+    mcus = [SimulatedMCU(args[0], "%s%d" % (options.prefix, i), model,
+                         "%s%d.log" % (options.prefix, i))
+            for i in range(options.count)]
+    links = LinkSimulator(mcus)
+    links.start()
+    try:
+        if options.config is not None:
+            run_benchmark(options, mcus)
+        else:
+            sys.stderr.write("Simulating %d micro-controllers at %s\n"
+                             % (len(mcus), " ".join([m.ptyname
+                                                     for m in mcus])))
+            while 1:
+                time.sleep(1.)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        links.stop()
+        for m in mcus:
+            m.close()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# Read the printer status exported by the [status_shm] module
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, optparse, mmap, struct, time, json
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', 'klippy'))
+from extras import status_shm as ss
+
+class StatusReader:
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            self.shm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        hdr = struct.unpack_from(ss.HEADER_FORMAT, self.shm, 0)
+        (magic, version, size, seq, self.heater_count, self.mcu_count,
+         names_offset, self.data_offset, reserved) = hdr
+        if magic != ss.SHM_MAGIC or version != ss.SHM_VERSION:
+            raise ValueError("Unsupported status file '%s'" % (filename,))
+        self.data_size = size - self.data_offset
+        names = []
+        for i in range(self.heater_count + self.mcu_count):
+            offset = names_offset + i * ss.NAME_SIZE
+            name = self.shm[offset:offset + ss.NAME_SIZE]
+            names.append(name.split(b'\0', 1)[0].decode())
+        self.heater_names = names[:self.heater_count]
+        self.mcu_names = names[self.heater_count:]
+    def _read_data(self):
+        # Copy the data, retrying if it was updated during the copy
+        shm = self.shm
+        start, end = self.data_offset, self.data_offset + self.data_size
+        while 1:
+            seq1 = struct.unpack_from("<I", shm, ss.SEQUENCE_OFFSET)[0]
+            if seq1 & 1:
+                continue
+            data = shm[start:end]
+            seq2 = struct.unpack_from("<I", shm, ss.SEQUENCE_OFFSET)[0]
+            if seq1 == seq2:
+                return seq1, data
+    def read(self):
+        seq, data = self._read_data()
+        vals = struct.unpack_from(ss.STATUS_FORMAT, data, 0)
+        res = {'sequence': seq, 'update_time': vals[0],
+               'live_position': list(vals[1:5]), 'live_velocity': vals[5],
+               'live_extruder_velocity': vals[6], 'print_duration': vals[7],
+               'total_duration': vals[8], 'filament_used': vals[9],
+               'progress': vals[10],
+               'printer_state': ss.PRINTER_STATES[vals[11]],
+               'print_state': ss.PRINT_STATES[vals[12]],
+               'current_layer': vals[13], 'total_layer': vals[14]}
+        offset = ss.STATUS_SIZE
+        heaters = res['heaters'] = {}
+        for name in self.heater_names:
+            temp, target, power = struct.unpack_from(ss.HEATER_FORMAT, data,
+                                                     offset)
+            heaters[name] = {'temperature': temp, 'target': target,
+                             'power': power}
+            offset += ss.HEATER_SIZE
+        mcus = res['mcus'] = {}
+        for name in self.mcu_names:
+            vals = struct.unpack_from(ss.MCU_FORMAT, data, offset)
+            mcus[name] = dict(zip(ss.MCU_FLOAT_STATS + ss.MCU_INT_STATS, vals))
+            offset += ss.MCU_SIZE
+        return res
+
+def main():
+    usage = "%prog [options] <status file>"
+    opts = optparse.OptionParser(usage)
+    opts.add_option("-i", "--interval", type="float", dest="interval",
+                    default=0., help="report the status every INTERVAL"
+                    " seconds (default is to report once)")
+    options, args = opts.parse_args()
+    if len(args) != 1:
+        opts.error("Incorrect number of arguments")
+    reader = StatusReader(args[0])
+    while 1:
+        status = reader.read()
+        sys.stdout.write(json.dumps(status, sort_keys=True) + "\n")
+        sys.stdout.flush()
+        if options.interval <= 0. or status['printer_state'] == 'disconnected':
+            break
+        time.sleep(options.interval)
+
+if __name__ == '__main__':
+    main()
@@ -36,7 +36,9 @@ class TestCase:
         # Parse file into test cases
         config_fname = gcode_fname = dict_fnames = None
         should_fail = multi_tests = False
+        fail_msg = None
         gcode = []
+        check_script = None
         f = open(self.fname, 'r')
         for line in f:
             cpos = line.find('#')
@@ -51,11 +53,13 @@ class TestCase:
                     if not multi_tests:
                         multi_tests = True
                         self.launch_test(config_fname, dict_fnames,
-                                         gcode_fname, gcode, should_fail)
+                                         gcode_fname, gcode, should_fail,
+                                         fail_msg, check_script)
                 config_fname = self.relpath(parts[1])
                 if multi_tests:
                     self.launch_test(config_fname, dict_fnames,
-                                     gcode_fname, gcode, should_fail)
+                                     gcode_fname, gcode, should_fail,
+                                     fail_msg, check_script)
             elif parts[0] == "DICTIONARY":
                 dict_fnames = [self.relpath(parts[1], 'dict')]
                 for mcu_dict in parts[2:]:
@@ -66,14 +70,18 @@ class TestCase:
                 gcode_fname = self.relpath(parts[1])
             elif parts[0] == "SHOULD_FAIL":
                 should_fail = True
+                if len(parts) > 1:
+                    fail_msg = ' '.join(parts[1:])
+            elif parts[0] == "CHECK_SCRIPT":
+                check_script = [self.relpath(parts[1])] + parts[2:]
             else:
                 gcode.append(line.strip())
         f.close()
         if not multi_tests:
-            self.launch_test(config_fname, dict_fnames,
-                             gcode_fname, gcode, should_fail)
+            self.launch_test(config_fname, dict_fnames, gcode_fname, gcode,
+                             should_fail, fail_msg, check_script)
     def launch_test(self, config_fname, dict_fnames, gcode_fname, gcode,
-                    should_fail):
+                    should_fail, fail_msg, check_script):
         gcode_is_temp = False
         if gcode_fname is None:
             gcode_fname = self.relpath(TEMP_GCODE_FILE, 'temp')
@@ -94,9 +102,13 @@ class TestCase:
                  '-i', gcode_fname, '-o', TEMP_OUTPUT_FILE, '-v' ]
         for df in dict_fnames:
             args += ['-d', df]
-        if not self.verbose:
+        # The log is needed to check for an expected error message
+        use_log = not self.verbose or fail_msg is not None
+        if use_log:
             args += ['-l', TEMP_LOG_FILE]
         res = subprocess.call(args)
+        if self.verbose and use_log:
+            self.show_log()
         is_fail = (should_fail and not res) or (not should_fail and res)
         if is_fail:
             if not self.verbose:
@@ -104,15 +116,26 @@ class TestCase:
             if should_fail:
                 raise error("Test failed to raise an error")
             raise error("Error during test")
+        if fail_msg is not None and fail_msg not in self.read_log():
+            if not self.verbose:
+                self.show_log()
+            raise error("Test did not report error '%s'" % (fail_msg,))
+        # Run script that checks the files produced by the test
+        if check_script is not None and not should_fail:
+            res = subprocess.call([sys.executable] + check_script)
+            if res:
+                if not self.verbose:
+                    self.show_log()
+                raise error("Check script failed")
         # Do cleanup
         if self.keepfiles:
             return
         for fname in os.listdir(self.tempdir):
             if fname.startswith(TEMP_OUTPUT_FILE):
                 os.unlink(fname)
-        if not self.verbose:
+        if use_log:
             os.unlink(TEMP_LOG_FILE)
-        else:
+        if self.verbose:
             sys.stderr.write('\n')
         if gcode_is_temp:
             os.unlink(gcode_fname)
@@ -125,11 +148,13 @@ class TestCase:
             logging.exception("Unhandled exception during test run")
             return "internal error"
         return "success"
-    def show_log(self):
+    def read_log(self):
         f = open(TEMP_LOG_FILE, 'r')
         data = f.read()
         f.close()
-        sys.stdout.write(data)
+        return data
+    def show_log(self):
+        sys.stdout.write(self.read_log())
 
 
 ######################################################################
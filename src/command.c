@@ -53,22 +53,6 @@ f4: *p++ = v & 0x7f;
     return p;
 }
 
-// Parse an integer that was encoded as a "variable length quantity"
-static uint32_t
-parse_int(uint8_t **pp)
-{
-    uint8_t *p = *pp, c = *p++;
-    uint32_t v = c & 0x7f;
-    if ((c & 0x60) == 0x60)
-        v |= -0x20;
-    while (c & 0x80) {
-        c = *p++;
-        v = (v<<7) | (c & 0x7f);
-    }
-    *pp = p;
-    return v;
-}
-
 // Write an encoded msgid (optimized 2-byte VLQ encoder)
 static uint8_t *
 encode_msgid(uint8_t *p, uint_fast16_t encoded_msgid)
@@ -109,7 +93,7 @@ command_parsef(uint8_t *p, uint8_t *maxend
         case PT_uint16:
         case PT_int16:
         case PT_byte:
-            *args++ = parse_int(&p);
+            *args++ = command_parse_int(&p);
             break;
         case PT_buffer: {
             uint_fast8_t len = *p++;
@@ -126,6 +110,13 @@ command_parsef(uint8_t *p, uint8_t *maxend
     }
     return p;
 error:
+    command_parse_error();
+}
+
+// Report an invalid command (also used by ctr_dispatch_fast())
+void
+command_parse_error(void)
+{
     shutdown("Command parser error");
 }
 
@@ -332,6 +323,14 @@ command_dispatch(uint8_t *buf, uint_fast8_t msglen)
     uint8_t *msgend = &buf[msglen-MESSAGE_TRAILER_SIZE];
     while (p < msgend) {
         uint_fast16_t cmdid = command_parse_msgid(&p);
+        if (likely(!sched_is_shutdown())) {
+            // Try commands with a generated parser first
+            uint8_t *np = ctr_dispatch_fast(cmdid, p, msgend);
+            if (np) {
+                p = np;
+                continue;
+            }
+        }
         const struct command_parser *cp = command_lookup_parser(cmdid);
         uint32_t args[READP(cp->num_args)];
         p = command_parsef(p, msgend, cp, args);
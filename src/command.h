@@ -12,9 +12,14 @@
              __stringify(FLAGS) " " MSG)
 #define DECL_COMMAND(FUNC, MSG)                 \
     DECL_COMMAND_FLAGS(FUNC, 0, MSG)
+// Declare a frequently used command (the build generates a
+// specialized parser for it - integer parameters only)
+#define DECL_COMMAND_FAST(FUNC, MSG)            \
+    DECL_COMMAND_FLAGS(FUNC, HF_FAST_PARSE, MSG)
 
 // Flags for command handler declarations.
 #define HF_IN_SHUTDOWN   0x01   // Handler can run even when in emergency stop
+#define HF_FAST_PARSE    0x02   // Handler uses a generated parser
 
 // Declare a constant exported to the host
 #define DECL_CONSTANT(NAME, VALUE)                              \
@@ -72,8 +77,25 @@ enum {
     PT_string, PT_progmem_buffer, PT_buffer,
 };
 
+// Parse an integer that was encoded as a "variable length quantity"
+static inline uint32_t
+command_parse_int(uint8_t **pp)
+{
+    uint8_t *p = *pp, c = *p++;
+    uint32_t v = c & 0x7f;
+    if ((c & 0x60) == 0x60)
+        v |= -0x20;
+    while (c & 0x80) {
+        c = *p++;
+        v = (v<<7) | (c & 0x7f);
+    }
+    *pp = p;
+    return v;
+}
+
 // command.c
 void *command_decode_ptr(uint32_t v);
+void command_parse_error(void) __noreturn;
 uint_fast16_t command_parse_msgid(uint8_t **pp);
 uint8_t *command_parsef(uint8_t *p, uint8_t *maxend
                         , const struct command_parser *cp, uint32_t *args);
@@ -95,6 +117,7 @@ extern const uint32_t command_identify_size;
 const struct command_encoder *ctr_lookup_encoder(const char *str);
 const struct command_encoder *ctr_lookup_output(const char *str);
 uint8_t ctr_lookup_static_string(const char *str);
+uint8_t *ctr_dispatch_fast(uint_fast16_t cmdid, uint8_t *p, uint8_t *maxend);
 
 #define _DECL_ENCODER(FMT) ({                   \
     DECL_CTR("_DECL_ENCODER " FMT);             \
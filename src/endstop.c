@@ -4,9 +4,11 @@
 //
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
+#include "autoconf.h" // CONFIG_WANT_ENDSTOP_GROUP
 #include "basecmd.h" // oid_alloc
 #include "board/gpio.h" // struct gpio
 #include "board/irq.h" // irq_disable
+#include "board/misc.h" // timer_is_before
 #include "command.h" // DECL_COMMAND
 #include "sched.h" // struct timer
 #include "trsync.h" // trsync_do_trigger
@@ -16,10 +18,11 @@ struct endstop {
     struct gpio_in pin;
     uint32_t rest_time, sample_time, nextwake;
     struct trsync *ts;
+    struct endstop_group *group;
     uint8_t flags, sample_count, trigger_count, trigger_reason;
 };
 
-enum { ESF_PIN_HIGH=1<<0, ESF_HOMING=1<<1 };
+enum { ESF_PIN_HIGH=1<<0, ESF_HOMING=1<<1, ESF_SAMPLING=1<<2 };
 
 static uint_fast8_t endstop_oversample_event(struct timer *t);
 
@@ -71,12 +74,127 @@ command_config_endstop(uint32_t *args)
 }
 DECL_COMMAND(command_config_endstop, "config_endstop oid=%c pin=%c pull_up=%c");
 
+
+/****************************************************************
+ * Endstop groups
+ ****************************************************************/
+
+// An endstop group samples several endstops from a single timer
+
+struct endstop_group {
+    struct timer time;
+    uint8_t endstop_count, max_endstops, flags;
+    struct endstop *endstops[];
+};
+
+enum { EGF_ACTIVE=1<<0 };
+
+// Make sure the group timer runs no later than a newly started endstop
+static void
+endstop_group_wake(struct endstop_group *g, uint32_t waketime)
+{
+    if (g->flags & EGF_ACTIVE) {
+        if (!timer_is_before(waketime, g->time.waketime))
+            return;
+        sched_del_timer(&g->time);
+    }
+    g->flags |= EGF_ACTIVE;
+    g->time.waketime = waketime;
+    sched_add_timer(&g->time);
+}
+
+#if CONFIG_WANT_ENDSTOP_GROUP
+// Timer callback for a group of endstops
+static uint_fast8_t
+endstop_group_event(struct timer *t)
+{
+    struct endstop_group *g = container_of(t, struct endstop_group, time);
+    uint32_t waketime = g->time.waketime, next_waketime = 0;
+    uint_fast8_t i, have_next = 0;
+    for (i=0; i<g->endstop_count; i++) {
+        struct endstop *e = g->endstops[i];
+        if (!(e->flags & ESF_SAMPLING))
+            continue;
+        if (!timer_is_before(waketime, e->time.waketime)) {
+            // Run the endstop's sampling code with its own timer state
+            if (e->time.func(&e->time) == SF_DONE) {
+                e->flags &= ~ESF_SAMPLING;
+                continue;
+            }
+        }
+        uint32_t e_waketime = e->time.waketime;
+        if (!have_next || timer_is_before(e_waketime, next_waketime)) {
+            next_waketime = e_waketime;
+            have_next = 1;
+        }
+    }
+    if (!have_next) {
+        g->flags &= ~EGF_ACTIVE;
+        return SF_DONE;
+    }
+    g->time.waketime = next_waketime;
+    return SF_RESCHEDULE;
+}
+
+void
+command_config_endstop_group(uint32_t *args)
+{
+    uint8_t max_endstops = args[1];
+    struct endstop_group *g = oid_alloc(
+        args[0], command_config_endstop_group
+        , sizeof(*g) + sizeof(g->endstops[0]) * max_endstops);
+    g->max_endstops = max_endstops;
+    g->time.func = endstop_group_event;
+}
+DECL_COMMAND(command_config_endstop_group,
+             "config_endstop_group oid=%c endstop_count=%c");
+
+// Add an endstop to a group (must be done before the endstop is used)
+void
+command_endstop_group_add(uint32_t *args)
+{
+    struct endstop_group *g = oid_lookup(args[0]
+                                         , command_config_endstop_group);
+    struct endstop *e = oid_lookup(args[1], command_config_endstop);
+    if (g->endstop_count >= g->max_endstops || e->group || e->flags)
+        shutdown("Invalid endstop group member");
+    g->endstops[g->endstop_count++] = e;
+    e->group = g;
+}
+DECL_COMMAND(command_endstop_group_add,
+             "endstop_group_add oid=%c endstop_oid=%c");
+
+void
+endstop_group_shutdown(void)
+{
+    // The scheduler removes all timers on a shutdown
+    uint8_t i;
+    struct endstop_group *g;
+    foreach_oid(i, g, command_config_endstop_group) {
+        g->flags = 0;
+    }
+}
+DECL_SHUTDOWN(endstop_group_shutdown);
+#endif
+
+
+/****************************************************************
+ * Homing
+ ****************************************************************/
+
 // Home an axis
 void
 command_endstop_home(uint32_t *args)
 {
     struct endstop *e = oid_lookup(args[0], command_config_endstop);
-    sched_del_timer(&e->time);
+    struct endstop_group *g = e->group;
+    if (CONFIG_WANT_ENDSTOP_GROUP && g) {
+        irq_disable();
+        e->flags &= ~ESF_SAMPLING;
+        irq_enable();
+    } else {
+        sched_del_timer(&e->time);
+    }
     e->time.waketime = args[1];
     e->sample_time = args[2];
     e->sample_count = args[3];
@@ -92,6 +210,13 @@ command_endstop_home(uint32_t *args)
     e->flags = ESF_HOMING | (args[5] ? ESF_PIN_HIGH : 0);
     e->ts = trsync_oid_lookup(args[6]);
     e->trigger_reason = args[7];
+    if (CONFIG_WANT_ENDSTOP_GROUP && g) {
+        irq_disable();
+        e->flags |= ESF_SAMPLING;
+        endstop_group_wake(g, e->time.waketime);
+        irq_enable();
+        return;
+    }
     sched_add_timer(&e->time);
 }
 DECL_COMMAND(command_endstop_home,
@@ -11,6 +11,7 @@
 #include <pty.h> // openpty
 #include <stdio.h> // fprintf
 #include <string.h> // memmove
+#include <sys/epoll.h> // epoll_wait
 #include <sys/stat.h> // chmod
 #include <time.h> // struct timespec
 #include <unistd.h> // ttyname
@@ -23,6 +24,10 @@
 static struct pollfd main_pfd[1];
 #define MP_TTY_IDX   0
 
+// epoll tracking (CONFIG_LINUX_TIMERFD)
+static int main_epoll_fd = -1;
+enum { EP_TTY, EP_TIMER };
+
 // Report 'errno' in a message written to stderr
 void
 report_errno(char *where, int rc)
@@ -85,6 +90,19 @@ console_setup(char *name)
         return -1;
     main_pfd[MP_TTY_IDX].fd = mfd;
     main_pfd[MP_TTY_IDX].events = POLLIN;
+    if (CONFIG_LINUX_TIMERFD) {
+        main_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (main_epoll_fd < 0) {
+            report_errno("epoll_create1", main_epoll_fd);
+            return -1;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = EP_TTY };
+        ret = epoll_ctl(main_epoll_fd, EPOLL_CTL_ADD, mfd, &ev);
+        if (ret) {
+            report_errno("epoll_ctl tty", ret);
+            return -1;
+        }
+    }
 
     // Create symlink to tty
     unlink(name);
@@ -178,10 +196,47 @@ console_sendf(const struct command_encoder *ce, va_list args)
         report_errno("write", ret);
 }
 
+// Register the timerfd used for timer wakeups with console_sleep()
+int
+console_add_timer_fd(int fd)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = EP_TIMER };
+    int ret = epoll_ctl(main_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    if (ret) {
+        report_errno("epoll_ctl timerfd", ret);
+        return -1;
+    }
+    return 0;
+}
+
+// Sleep until the timerfd or console input is ready
+static void
+console_epoll_sleep(void)
+{
+    struct epoll_event events[2];
+    int ret = epoll_wait(main_epoll_fd, events, ARRAY_SIZE(events), -1);
+    if (ret <= 0) {
+        if (errno != EINTR)
+            report_errno("epoll_wait", ret);
+        return;
+    }
+    int i;
+    for (i=0; i<ret; i++) {
+        if (events[i].data.u32 == EP_TIMER)
+            timer_fd_event();
+        else
+            sched_wake_task(&console_wake);
+    }
+}
+
 // Sleep until a signal received (waking early for console input if needed)
 void
 console_sleep(sigset_t *sigset)
 {
+    if (CONFIG_LINUX_TIMERFD) {
+        console_epoll_sleep();
+        return;
+    }
     int ret = ppoll(main_pfd, ARRAY_SIZE(main_pfd), NULL, sigset);
     if (ret <= 0) {
         if (errno != EINTR)
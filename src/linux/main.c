@@ -4,8 +4,10 @@
 //
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
+#define _GNU_SOURCE
 #include <sched.h> // sched_setscheduler sched_get_priority_max
 #include <stdio.h> // fprintf
+#include <stdlib.h> // atoi
 #include <string.h> // memset
 #include <unistd.h> // getopt
 #include <sys/mman.h> // mlockall MCL_CURRENT MCL_FUTURE
@@ -41,6 +43,21 @@ realtime_setup(void)
     return 0;
 }
 
+// Restrict the process to a single cpu
+static int
+cpu_pin_setup(int cpu)
+{
+    cpu_set_t cs;
+    CPU_ZERO(&cs);
+    CPU_SET(cpu, &cs);
+    int ret = sched_setaffinity(0, sizeof(cs), &cs);
+    if (ret < 0) {
+        report_errno("sched_setaffinity", ret);
+        return -1;
+    }
+    return 0;
+}
+
 
 /****************************************************************
  * Restart
@@ -68,9 +85,9 @@ main(int argc, char **argv)
 {
     // Parse program args
     orig_argv = argv;
-    int opt, watchdog = 0, realtime = 0;
+    int opt, watchdog = 0, realtime = 0, cpu = -1;
     char *serial = "/tmp/klipper_host_mcu";
-    while ((opt = getopt(argc, argv, "wrI:")) != -1) {
+    while ((opt = getopt(argc, argv, "wrc:I:")) != -1) {
         switch (opt) {
         case 'w':
             watchdog = 1;
@@ -78,16 +95,25 @@ main(int argc, char **argv)
         case 'r':
             realtime = 1;
             break;
+        case 'c':
+            cpu = atoi(optarg);
+            break;
         case 'I':
             serial = optarg;
             break;
         default:
-            fprintf(stderr, "Usage: %s [-w] [-r] [-I path]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-w] [-r] [-c cpu] [-I path]\n"
+                    , argv[0]);
             return -1;
         }
     }
 
     // Initial setup
+    if (cpu >= 0) {
+        int ret = cpu_pin_setup(cpu);
+        if (ret)
+            return ret;
+    }
     if (realtime) {
         int ret = realtime_setup();
         if (ret)
@@ -4,7 +4,11 @@
 //
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
+#include <stddef.h> // offsetof
+#include <string.h> // memset
+#include <sys/timerfd.h> // timerfd_create
 #include <time.h> // struct timespec
+#include <unistd.h> // read
 #include "autoconf.h" // CONFIG_CLOCK_FREQ
 #include "board/io.h" // readl
 #include "board/irq.h" // irq_disable
@@ -22,11 +26,13 @@ static struct {
     // Flags for tracking irq_enable()/irq_disable()
     uint32_t must_wake_timers;
     // Time of next software timer (also used to convert from ticks to systime)
-    uint32_t next_wake_counter;
+    uint32_t next_wake_counter, wake_armed;
     struct timespec next_wake;
     // Unix signal tracking
     timer_t t_alarm;
     sigset_t ss_alarm, ss_sleep;
+    // timerfd tracking (CONFIG_LINUX_TIMERFD)
+    int timer_fd;
 } TimerInfo;
 
 
@@ -72,6 +78,54 @@ timespec_read(void)
 }
 
 
+/****************************************************************
+ * Timer dispatch latency statistics
+ ****************************************************************/
+
+#define LATENCY_BUCKETS 5
+
+static const uint16_t latency_bucket_us[LATENCY_BUCKETS] = {
+    2, 10, 50, 200, 1000
+};
+
+static struct {
+    uint32_t count, max, buckets[LATENCY_BUCKETS];
+    uint32_t report_time;
+} LatencyStats;
+
+// Note the time between a requested timer wakeup and its dispatch
+static void
+latency_update(uint32_t latency)
+{
+    LatencyStats.count++;
+    if (latency > LatencyStats.max)
+        LatencyStats.max = latency;
+    int i;
+    for (i=0; i<LATENCY_BUCKETS; i++) {
+        if (latency < latency_bucket_us[i] * (CONFIG_CLOCK_FREQ / 1000000)) {
+            LatencyStats.buckets[i]++;
+            break;
+        }
+    }
+}
+
+// Periodically report timer dispatch latency
+void
+latency_stats_task(void)
+{
+    uint32_t lrt = TimerInfo.last_read_time;
+    if (timer_is_before(lrt, LatencyStats.report_time))
+        return;
+    LatencyStats.report_time = lrt + timer_from_us(5000000);
+    uint32_t *b = LatencyStats.buckets;
+    sendf("timer_latency count=%u max=%u under_2us=%u under_10us=%u"
+          " under_50us=%u under_200us=%u under_1ms=%u"
+          , LatencyStats.count, LatencyStats.max, b[0], b[1], b[2], b[3], b[4]);
+    memset(&LatencyStats, 0, offsetof(typeof(LatencyStats), report_time));
+}
+DECL_TASK(latency_stats_task);
+
+
 /****************************************************************
  * Timers
  ****************************************************************/
@@ -118,6 +172,12 @@ timer_read_time(void)
 void
 timer_kick(void)
 {
+    TimerInfo.wake_armed = 0;
+    if (CONFIG_LINUX_TIMERFD) {
+        // No signal needed - the timer is checked on the next irq_poll()
+        TimerInfo.must_wake_timers = 1;
+        return;
+    }
     struct itimerspec it = { .it_interval = {0, 0}, .it_value = {0, 1} };
     timer_settime(TimerInfo.t_alarm, TIMER_ABSTIME, &it, NULL);
 }
@@ -126,11 +186,23 @@ timer_kick(void)
 #define TIMER_REPEAT_COUNT 20
 
 #define TIMER_MIN_TRY_TICKS timer_from_us(2)
+#define TIMER_FINE_WAIT_TICKS timer_from_us(50)
 
 // Invoke timers
 static void
 timer_dispatch(void)
 {
+    if (TimerInfo.wake_armed) {
+        int32_t late = timer_read_time() - TimerInfo.next_wake_counter;
+        if (late < 0) {
+            // Stale wakeup event - wait for the scheduled wakeup
+            TimerInfo.must_wake_timers = 0;
+            return;
+        }
+        latency_update(late);
+        TimerInfo.wake_armed = 0;
+    }
+
     uint32_t repeat_count = TIMER_REPEAT_COUNT, next;
     for (;;) {
         // Run the next software timer
@@ -144,9 +216,15 @@ timer_dispatch(void)
 
         uint32_t now = timer_read_time();
         int32_t diff = next - now;
-        if (diff > (int32_t)TIMER_MIN_TRY_TICKS)
-            // Schedule next timer normally.
-            break;
+        if (diff > (int32_t)TIMER_MIN_TRY_TICKS) {
+            if (!CONFIG_LINUX_TIMERFD || diff > (int32_t)TIMER_FINE_WAIT_TICKS)
+                // Schedule next timer normally.
+                break;
+            // Next timer in the near future - sleep until it is ready
+            struct timespec ts = timespec_from_time(next);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            diff = next - timer_read_time();
+        }
 
         if (unlikely(!repeat_count)) {
             // Check if there are too many repeat timers
@@ -162,13 +240,17 @@ timer_dispatch(void)
             diff = next - timer_read_time();
     }
 
-    // Schedule SIGALRM signal
+    // Schedule SIGALRM signal (or timerfd wakeup)
     struct itimerspec it;
     it.it_interval = (struct timespec){0, 0};
     TimerInfo.next_wake = it.it_value = timespec_from_time(next);
     TimerInfo.next_wake_counter = next;
+    TimerInfo.wake_armed = 1;
     TimerInfo.must_wake_timers = 0;
-    timer_settime(TimerInfo.t_alarm, TIMER_ABSTIME, &it, NULL);
+    if (CONFIG_LINUX_TIMERFD)
+        timerfd_settime(TimerInfo.timer_fd, TFD_TIMER_ABSTIME, &it, NULL);
+    else
+        timer_settime(TimerInfo.t_alarm, TIMER_ABSTIME, &it, NULL);
 }
 
 // OS signal handler
@@ -178,9 +260,44 @@ timer_signal(int signal)
     TimerInfo.must_wake_timers = 1;
 }
 
+// Handle a timerfd expiration reported by console_sleep()
+void
+timer_fd_event(void)
+{
+    uint64_t expirations;
+    int ret = read(TimerInfo.timer_fd, &expirations, sizeof(expirations));
+    if (ret > 0)
+        TimerInfo.must_wake_timers = 1;
+}
+
+// Setup timerfd based timer wakeups
+static void
+timer_fd_init(void)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        report_errno("timerfd_create", fd);
+        return;
+    }
+    TimerInfo.timer_fd = fd;
+    int ret = console_add_timer_fd(fd);
+    if (ret)
+        return;
+    timer_kick();
+}
+
 void
 timer_init(void)
 {
+    // Initialize timespec_to_time() and timespec_from_time()
+    struct timespec curtime = timespec_read();
+    TimerInfo.start_sec = curtime.tv_sec + 1;
+    TimerInfo.next_wake = curtime;
+    TimerInfo.next_wake_counter = timespec_to_time(curtime);
+    if (CONFIG_LINUX_TIMERFD) {
+        timer_fd_init();
+        return;
+    }
     // Initialize ss_alarm signal set
     int ret = sigemptyset(&TimerInfo.ss_alarm);
     if (ret < 0) {
@@ -203,11 +320,6 @@ timer_init(void)
         report_errno("sigdelset", ret);
         return;
     }
-    // Initialize timespec_to_time() and timespec_from_time()
-    struct timespec curtime = timespec_read();
-    TimerInfo.start_sec = curtime.tv_sec + 1;
-    TimerInfo.next_wake = curtime;
-    TimerInfo.next_wake_counter = timespec_to_time(curtime);
     // Initialize t_alarm signal based timer
     ret = timer_create(CLOCK_MONOTONIC, NULL, &TimerInfo.t_alarm);
     if (ret < 0) {
@@ -228,14 +340,16 @@ DECL_INIT(timer_init);
 void
 timer_disable_signals(void)
 {
-    sigprocmask(SIG_BLOCK, &TimerInfo.ss_alarm, NULL);
+    if (!CONFIG_LINUX_TIMERFD)
+        sigprocmask(SIG_BLOCK, &TimerInfo.ss_alarm, NULL);
 }
 
 // Restore reception of SIGALRM signal
 void
 timer_enable_signals(void)
 {
-    sigprocmask(SIG_UNBLOCK, &TimerInfo.ss_alarm, NULL);
+    if (!CONFIG_LINUX_TIMERFD)
+        sigprocmask(SIG_UNBLOCK, &TimerInfo.ss_alarm, NULL);
 }
 
 
@@ -282,4 +396,9 @@ irq_poll(void)
 {
     if (readl(&TimerInfo.must_wake_timers))
         timer_dispatch();
+    else if (CONFIG_LINUX_TIMERFD && TimerInfo.wake_armed
+             && !timer_is_before(timer_read_time()
+                                 , TimerInfo.next_wake_counter))
+        // Timer is due (no need to wait for the timerfd event)
+        timer_dispatch();
 }
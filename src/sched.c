@@ -63,6 +63,19 @@ static struct timer sentinel_timer = {
     .waketime = 0x80000000,
 };
 
+// The deleted timer is used when deleting an active timer.
+static uint_fast8_t
+deleted_event(struct timer *t)
+{
+    return SF_DONE;
+}
+
+static struct timer deleted_timer = {
+    .func = deleted_event,
+};
+
+#if !CONFIG_SCHED_PAIRING_HEAP
+
 // Find position for a timer in timer_list and insert it
 static void __always_inline
 insert_timer(struct timer *pos, struct timer *t, uint32_t waketime)
@@ -106,17 +119,6 @@ sched_add_timer(struct timer *add)
     irq_restore(flag);
 }
 
-// The deleted timer is used when deleting an active timer.
-static uint_fast8_t
-deleted_event(struct timer *t)
-{
-    return SF_DONE;
-}
-
-static struct timer deleted_timer = {
-    .func = deleted_event,
-};
-
 // Remove a timer that may be live.
 void
 sched_del_timer(struct timer *del)
@@ -189,6 +191,277 @@ sched_timer_reset(void)
     timer_kick();
 }
 
+#else // CONFIG_SCHED_PAIRING_HEAP
+
+// With CONFIG_SCHED_PAIRING_HEAP the timers are stored in a "pairing
+// heap" instead of a sorted list.  The heap root (timer_list) is the
+// next timer to run.  Each timer links to its first child (t->child)
+// and to its next sibling (t->next), while t->prev points to the
+// previous sibling (or the parent of a first child).  A timer that is
+// not on the heap (or is the root) has a NULL t->prev.
+
+// Combine two heaps ('a' remains the root if the waketimes match)
+static struct timer *
+heap_meld(struct timer *a, struct timer *b)
+{
+    if (timer_is_before(b->waketime, a->waketime)) {
+        struct timer *t = a;
+        a = b;
+        b = t;
+    }
+    struct timer *child = a->child;
+    b->next = child;
+    if (child)
+        child->prev = b;
+    b->prev = a;
+    a->child = b;
+    return a;
+}
+
+// Combine a list of sibling heaps into a single heap
+static struct timer *
+heap_merge_pairs(struct timer *first)
+{
+    if (!first)
+        return NULL;
+    // Meld pairs from left to right (building a reversed list)
+    struct timer *pairs = NULL;
+    while (first) {
+        struct timer *a = first, *b = a->next;
+        if (!b) {
+            a->next = pairs;
+            pairs = a;
+            break;
+        }
+        first = b->next;
+        a = heap_meld(a, b);
+        a->next = pairs;
+        pairs = a;
+    }
+    // Meld the pairs from right to left
+    struct timer *root = pairs;
+    pairs = pairs->next;
+    while (pairs) {
+        struct timer *next = pairs->next;
+        root = heap_meld(root, pairs);
+        pairs = next;
+    }
+    root->next = root->prev = NULL;
+    return root;
+}
+
+// Remove a timer (that is not the heap root) from the heap
+static void
+heap_unlink(struct timer *del)
+{
+    struct timer *prev = del->prev, *next = del->next;
+    if (prev->child == del)
+        prev->child = next;
+    else
+        prev->next = next;
+    if (next)
+        next->prev = prev;
+    struct timer *sub = heap_merge_pairs(del->child);
+    if (sub)
+        SchedStatus.timer_list = heap_meld(SchedStatus.timer_list, sub);
+    del->child = del->prev = NULL;
+}
+
+// Schedule a function call at a supplied time.
+void
+sched_add_timer(struct timer *add)
+{
+    uint32_t waketime = add->waketime;
+    irqstatus_t flag = irq_save();
+    struct timer *tl = SchedStatus.timer_list;
+    add->child = NULL;
+    if (unlikely(timer_is_before(waketime, tl->waketime))) {
+        // This timer is before all other scheduled timers
+        if (timer_is_before(waketime, timer_read_time()))
+            try_shutdown("Timer too close");
+        if (tl == &deleted_timer)
+            tl = heap_merge_pairs(deleted_timer.child);
+        deleted_timer.waketime = waketime;
+        deleted_timer.child = NULL;
+        SchedStatus.timer_list = heap_meld(&deleted_timer, heap_meld(add, tl));
+        timer_kick();
+    } else {
+        SchedStatus.timer_list = heap_meld(tl, add);
+    }
+    irq_restore(flag);
+}
+
+// Remove a timer that may be live.
+void
+sched_del_timer(struct timer *del)
+{
+    irqstatus_t flag = irq_save();
+    if (SchedStatus.timer_list == del) {
+        // Deleting the next active timer - replace with deleted_timer
+        struct timer *tl = heap_merge_pairs(del->child);
+        deleted_timer.waketime = del->waketime;
+        deleted_timer.child = NULL;
+        SchedStatus.timer_list = heap_meld(&deleted_timer, tl);
+        del->child = NULL;
+    } else if (del->prev) {
+        // Unlink from heap and add its children back to the heap
+        heap_unlink(del);
+    }
+    irq_restore(flag);
+}
+
+// Invoke the next timer - called from board hardware irq code.
+unsigned int
+sched_timer_dispatch(void)
+{
+    // Invoke timer callback
+    struct timer *t = SchedStatus.timer_list;
+    uint_fast8_t res;
+    if (CONFIG_INLINE_STEPPER_HACK && likely(!t->func))
+        res = stepper_event(t);
+    else
+        res = t->func(t);
+
+    if (unlikely(SchedStatus.timer_list != t)) {
+        // The callback deleted its own timer (or added a timer before
+        // it) - the deleted_timer placeholder is now the heap root
+        struct timer *tl = SchedStatus.timer_list;
+        if (tl == &deleted_timer) {
+            tl = heap_merge_pairs(deleted_timer.child);
+            deleted_timer.child = NULL;
+            SchedStatus.timer_list = tl;
+        }
+        // Take the timer off the heap (the callback may have re-added
+        // it) and then reschedule it according to the callback result
+        if (tl == t) {
+            SchedStatus.timer_list = heap_merge_pairs(t->child);
+            t->child = NULL;
+        } else if (t->prev) {
+            heap_unlink(t);
+        }
+        if (res != SF_DONE)
+            SchedStatus.timer_list = heap_meld(SchedStatus.timer_list, t);
+        return SchedStatus.timer_list->waketime;
+    }
+
+    // Update heap (rescheduling current timer if necessary)
+    struct timer *child = t->child;
+    if (unlikely(res == SF_DONE)) {
+        t->child = NULL;
+        t = heap_merge_pairs(child);
+    } else if (child) {
+        t->child = NULL;
+        t = heap_meld(heap_merge_pairs(child), t);
+    }
+    SchedStatus.timer_list = t;
+    return t->waketime;
+}
+
+// Remove all user timers
+void
+sched_timer_reset(void)
+{
+    // Clear the heap links of the removed timers
+    struct timer *t = SchedStatus.timer_list;
+    while (t) {
+        struct timer *next = heap_merge_pairs(t->child);
+        t->child = t->prev = NULL;
+        t = next;
+    }
+    deleted_timer.waketime = periodic_timer.waketime;
+    SchedStatus.timer_list = heap_meld(&deleted_timer, &periodic_timer);
+    timer_kick();
+}
+
+#endif // CONFIG_SCHED_PAIRING_HEAP
+
+#if CONFIG_WANT_SCHED_BENCHMARK
+
+// The benchmark temporarily replaces all active timers with a set of
+// test timers that reschedule themselves at pseudo-random intervals.
+#define BENCH_MAX_TIMERS 64
+#define BENCH_MAX_ITERATIONS 1000000
+
+static struct {
+    struct timer timers[BENCH_MAX_TIMERS], sentinel;
+    uint32_t seed;
+} SchedBench;
+
+static uint_fast8_t
+bench_event(struct timer *t)
+{
+    uint32_t seed = SchedBench.seed * 1103515245 + 12345;
+    SchedBench.seed = seed;
+    uint32_t waketime = t->waketime + 64 + ((seed >> 16) & 0x3ff);
+#if CONFIG_SCHED_PAIRING_HEAP
+    if (!(seed & 0xf0000)) {
+        // Occasionally delete and re-add the timer from its callback
+        sched_del_timer(t);
+        t->waketime = waketime;
+        sched_add_timer(t);
+        return SF_RESCHEDULE;
+    }
+#endif
+    t->waketime = waketime;
+    return SF_RESCHEDULE;
+}
+
+void
+command_sched_benchmark(uint32_t *args)
+{
+    uint_fast8_t count = args[0];
+    uint32_t iterations = args[1];
+    if (!count || count > BENCH_MAX_TIMERS
+        || iterations > BENCH_MAX_ITERATIONS)
+        shutdown("Invalid sched_benchmark parameters");
+    irq_disable();
+    struct timer *save_list = SchedStatus.timer_list;
+    struct timer *save_last_insert = SchedStatus.last_insert;
+    struct timer save_deleted = deleted_timer;
+
+    // Setup test timers (the sentinel is never reached)
+    SchedBench.seed = 1;
+    struct timer *st = &SchedBench.sentinel, *t;
+    st->func = sentinel_event;
+    st->waketime = 0x7fffffff;
+    st->next = NULL;
+#if CONFIG_SCHED_PAIRING_HEAP
+    st->child = st->prev = NULL;
+    struct timer *root = st;
+    for (t = &SchedBench.timers[count-1]; t >= SchedBench.timers; t--) {
+        t->func = bench_event;
+        t->waketime = t - SchedBench.timers;
+        t->child = t->prev = NULL;
+        root = heap_meld(root, t);
+    }
+    SchedStatus.timer_list = root;
+#else
+    for (t = &SchedBench.timers[count-1]; t >= SchedBench.timers; t--) {
+        t->func = bench_event;
+        t->waketime = t - SchedBench.timers;
+        t->next = st;
+        st = t;
+    }
+    SchedStatus.timer_list = SchedStatus.last_insert = st;
+#endif
+
+    // Run timers
+    uint32_t start = timer_read_time(), i;
+    for (i=0; i<iterations; i++)
+        sched_timer_dispatch();
+    uint32_t end = timer_read_time();
+
+    SchedStatus.timer_list = save_list;
+    SchedStatus.last_insert = save_last_insert;
+    deleted_timer = save_deleted;
+    irq_enable();
+    sendf("sched_benchmark_result count=%c iterations=%u ticks=%u"
+          , count, iterations, end - start);
+}
+DECL_COMMAND(command_sched_benchmark, "sched_benchmark count=%c iterations=%u");
+
+#endif // CONFIG_WANT_SCHED_BENCHMARK
+
 
 /****************************************************************
  * Tasks
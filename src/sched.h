@@ -2,6 +2,7 @@
 #define __SCHED_H
 
 #include <stdint.h> // uint32_t
+#include "autoconf.h" // CONFIG_SCHED_PAIRING_HEAP
 #include "ctr.h" // DECL_CTR
 
 // Declare an init function (called at firmware startup)
@@ -16,6 +17,9 @@ struct timer {
     struct timer *next;
     uint_fast8_t (*func)(struct timer*);
     uint32_t waketime;
+#if CONFIG_SCHED_PAIRING_HEAP
+    struct timer *child, *prev;
+#endif
 };
 
 enum { SF_DONE=0, SF_RESCHEDULE=1 };
@@ -5,6 +5,7 @@
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
 #include <string.h> // memcpy
+#include "autoconf.h" // CONFIG_WANT_SENSOR_BULK_DECIMATION
 #include "board/irq.h" // irq_disable
 #include "board/misc.h" // timer_read_time
 #include "basecmd.h" // oid_alloc
@@ -76,25 +77,39 @@ adxl_query(struct adxl345 *ax, uint8_t oid)
     spidev_transfer(ax->spi, 1, sizeof(msg), msg);
     // Extract x, y, z measurements
     uint_fast8_t fifo_status = msg[8] & ~0x80; // Ignore trigger bit
-    uint8_t *d = &ax->sb.data[ax->sb.data_count];
-    if (((msg[2] & 0xf0) && (msg[2] & 0xf0) != 0xf0)
-        || ((msg[4] & 0xf0) && (msg[4] & 0xf0) != 0xf0)
-        || ((msg[6] & 0xf0) && (msg[6] & 0xf0) != 0xf0)
-        || (msg[7] != SET_FIFO_CTL) || (fifo_status > 32)) {
+    int is_error = (((msg[2] & 0xf0) && (msg[2] & 0xf0) != 0xf0)
+                    || ((msg[4] & 0xf0) && (msg[4] & 0xf0) != 0xf0)
+                    || ((msg[6] & 0xf0) && (msg[6] & 0xf0) != 0xf0)
+                    || (msg[7] != SET_FIFO_CTL) || (fifo_status > 32));
+    if (is_error)
         // Data error - may be a CS, MISO, MOSI, or SCLK glitch
-        d[0] = d[1] = d[2] = d[3] = d[4] = 0xff;
         fifo_status = 0;
+    if (ax->sb.delta_fields) {
+        // Delta packed samples
+        int16_t xyz[3] = { SENSOR_BULK_DELTA_ERROR, SENSOR_BULK_DELTA_ERROR
+                           , SENSOR_BULK_DELTA_ERROR };
+        if (!is_error) {
+            xyz[0] = (msg[2] << 8) | msg[1];
+            xyz[1] = (msg[4] << 8) | msg[3];
+            xyz[2] = (msg[6] << 8) | msg[5];
+        }
+        sensor_bulk_delta_add(&ax->sb, oid, xyz);
     } else {
-        // Copy data
-        d[0] = msg[1]; // x low bits
-        d[1] = msg[3]; // y low bits
-        d[2] = msg[5]; // z low bits
-        d[3] = (msg[2] & 0x1f) | (msg[6] << 5); // x high bits and z high bits
-        d[4] = (msg[4] & 0x1f) | ((msg[6] << 2) & 0x60); // y high and z high
+        uint8_t *d = &ax->sb.data[ax->sb.data_count];
+        if (is_error) {
+            d[0] = d[1] = d[2] = d[3] = d[4] = 0xff;
+        } else {
+            // Copy data
+            d[0] = msg[1]; // x low bits
+            d[1] = msg[3]; // y low bits
+            d[2] = msg[5]; // z low bits
+            d[3] = (msg[2] & 0x1f) | (msg[6] << 5); // x high and z high bits
+            d[4] = (msg[4] & 0x1f) | ((msg[6] << 2) & 0x60); // y high, z high
+        }
+        ax->sb.data_count += BYTES_PER_SAMPLE;
+        if (ax->sb.data_count + BYTES_PER_SAMPLE > ARRAY_SIZE(ax->sb.data))
+            sensor_bulk_report(&ax->sb, oid);
     }
-    ax->sb.data_count += BYTES_PER_SAMPLE;
-    if (ax->sb.data_count + BYTES_PER_SAMPLE > ARRAY_SIZE(ax->sb.data))
-        sensor_bulk_report(&ax->sb, oid);
     // Check fifo status
     if (fifo_status >= 31)
         ax->sb.possible_overflows++;
@@ -121,10 +136,26 @@ command_query_adxl345(uint32_t *args)
 
     // Start new measurements query
     ax->rest_ticks = args[1];
-    sensor_bulk_reset(&ax->sb);
+    if (args[2])
+        sensor_bulk_delta_reset(&ax->sb, 3, BYTES_PER_SAMPLE);
+    else
+        sensor_bulk_reset(&ax->sb);
     adxl_reschedule_timer(ax);
 }
-DECL_COMMAND(command_query_adxl345, "query_adxl345 oid=%c rest_ticks=%u");
+DECL_COMMAND(command_query_adxl345,
+             "query_adxl345 oid=%c rest_ticks=%u delta_packing=%c");
+
+#if CONFIG_WANT_SENSOR_BULK_DECIMATION
+void
+command_adxl345_set_decimation(uint32_t *args)
+{
+    struct adxl345 *ax = oid_lookup(args[0], command_config_adxl345);
+    sensor_bulk_set_decimation(&ax->sb, args[1], &args[2]);
+}
+DECL_COMMAND(command_adxl345_set_decimation,
+             "adxl345_set_decimation oid=%c factor=%c x_filter_oid=%c"
+             " y_filter_oid=%c z_filter_oid=%c");
+#endif
 
 void
 command_query_adxl345_status(uint32_t *args)
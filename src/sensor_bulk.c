@@ -4,8 +4,11 @@
 //
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
+#include <string.h> // memset
+#include "autoconf.h" // CONFIG_WANT_SENSOR_BULK_DECIMATION
 #include "command.h" // sendf
 #include "sensor_bulk.h" // sensor_bulk_report
+#include "sos_filter.h" // sosfilt
 
 // Reset counters
 void
@@ -14,6 +17,7 @@ sensor_bulk_reset(struct sensor_bulk *sb)
     sb->sequence = 0;
     sb->possible_overflows = 0;
     sb->data_count = 0;
+    sb->delta_fields = 0;
 }
 
 // Report local measurement buffer
@@ -26,13 +30,181 @@ sensor_bulk_report(struct sensor_bulk *sb, uint8_t oid)
     sb->sequence++;
 }
 
+// Number of chip samples in each reported sample
+static uint_fast8_t
+delta_factor(struct sensor_bulk *sb)
+{
+    return sb->decimate_factor > 1 ? sb->decimate_factor : 1;
+}
+
 // Report buffer and fifo status
 void
 sensor_bulk_status(struct sensor_bulk *sb, uint8_t oid
                    , uint32_t time1, uint32_t query_ticks, uint32_t fifo)
 {
+    uint32_t buffered = sb->data_count;
+    if (sb->delta_fields)
+        // Report pending samples using the chip's sample size
+        buffered = ((sb->delta_count * delta_factor(sb) + sb->decimate_count)
+                    * sb->delta_sample_size);
     sendf("sensor_bulk_status oid=%c clock=%u query_ticks=%u next_sequence=%hu"
           " buffered=%u possible_overflows=%hu"
           , oid, time1, query_ticks, sb->sequence
-          , sb->data_count + fifo, sb->possible_overflows);
+          , buffered + fifo, sb->possible_overflows);
+}
+
+
+/****************************************************************
+ * Delta packing
+ ****************************************************************/
+
+// In delta mode each sample is a set of int16 fields encoded as the
+// difference from the previous sample in the same message.  The
+// samples are written to a little-endian bit stream - each sample
+// starts with a 2-bit width code followed by each field's difference
+// using the number of bits selected by that code.  The first sample
+// of each message is relative to zero so that every message can be
+// decoded independently.  The message sequence is the index of its
+// first chip sample.  When decimation is enabled, each field is passed
+// through an sos_filter and only every 'decimate_factor' filtered
+// sample is reported.
+
+#define DELTA_CODE_BITS 2
+static const uint8_t delta_widths[] = { 4, 7, 10, 16 };
+
+// Reset counters and enable delta packing of samples
+void
+sensor_bulk_delta_reset(struct sensor_bulk *sb, uint8_t fields
+                        , uint8_t sample_size)
+{
+    sensor_bulk_reset(sb);
+    sb->delta_fields = fields;
+    sb->delta_sample_size = sample_size;
+    sb->delta_count = sb->delta_bits = 0;
+    memset(sb->delta_last, 0, sizeof(sb->delta_last));
+    sb->decimate_count = sb->decimate_error = 0;
+}
+
+// Append 'bits' low bits of 'val' to the message bit stream
+static void
+delta_put_bits(struct sensor_bulk *sb, uint_fast16_t val, uint_fast8_t bits)
+{
+    uint_fast16_t pos = sb->delta_bits;
+    sb->delta_bits = pos + bits;
+    for (;;) {
+        uint8_t *d = &sb->data[pos / 8];
+        uint_fast8_t shift = pos % 8, avail = 8 - shift;
+        if (!shift)
+            *d = 0;
+        if (bits <= avail) {
+            *d |= (val & ((1 << bits) - 1)) << shift;
+            return;
+        }
+        *d |= val << shift;
+        val >>= avail;
+        bits -= avail;
+        pos += avail;
+    }
+}
+
+// Find the smallest width code that can store a sample
+static uint_fast8_t
+delta_find_code(struct sensor_bulk *sb, int16_t *values)
+{
+    uint_fast8_t code, i, fields = sb->delta_fields;
+    for (code=0; code<ARRAY_SIZE(delta_widths)-1; code++) {
+        int_fast16_t limit = 1 << (delta_widths[code] - 1);
+        for (i=0; i<fields; i++) {
+            int16_t diff = values[i] - sb->delta_last[i];
+            if (diff < -limit || diff >= limit)
+                break;
+        }
+        if (i >= fields)
+            break;
+    }
+    return code;
+}
+
+#define DECIMATE_SHIFT 8
+
+// Filter a chip sample - returns true if a decimated sample is ready
+static int
+delta_decimate(struct sensor_bulk *sb, int16_t *values)
+{
+#if CONFIG_WANT_SENSOR_BULK_DECIMATION
+    uint_fast8_t i, fields = sb->delta_fields;
+    if (values[0] == SENSOR_BULK_DELTA_ERROR) {
+        sb->decimate_error = 1;
+    } else {
+        for (i=0; i<fields; i++) {
+            int32_t v = sosfilt(sb->decimate_filters[i]
+                                , (int32_t)values[i] << DECIMATE_SHIFT);
+            v = (v + (1 << (DECIMATE_SHIFT - 1))) >> DECIMATE_SHIFT;
+            if (v > INT16_MAX)
+                v = INT16_MAX;
+            else if (v <= SENSOR_BULK_DELTA_ERROR)
+                v = SENSOR_BULK_DELTA_ERROR + 1;
+            values[i] = v;
+        }
+    }
+    if (++sb->decimate_count < sb->decimate_factor)
+        return 0;
+    sb->decimate_count = 0;
+    if (sb->decimate_error) {
+        // Report an error if any chip sample in the period had an error
+        for (i=0; i<fields; i++)
+            values[i] = SENSOR_BULK_DELTA_ERROR;
+        sb->decimate_error = 0;
+    }
+#endif
+    return 1;
+}
+
+// Add a sample to the local measurement buffer (reporting it if full)
+void
+sensor_bulk_delta_add(struct sensor_bulk *sb, uint8_t oid, int16_t *values)
+{
+    if (sb->decimate_factor > 1 && !delta_decimate(sb, values))
+        return;
+    uint_fast8_t code = delta_find_code(sb, values), i;
+    uint_fast8_t fields = sb->delta_fields, width = delta_widths[code];
+    if (sb->delta_bits + DELTA_CODE_BITS + fields * width
+        > sizeof(sb->data) * 8) {
+        sensor_bulk_delta_report(sb, oid);
+        code = delta_find_code(sb, values);
+        width = delta_widths[code];
+    }
+    delta_put_bits(sb, code, DELTA_CODE_BITS);
+    for (i=0; i<fields; i++) {
+        delta_put_bits(sb, values[i] - sb->delta_last[i], width);
+        sb->delta_last[i] = values[i];
+    }
+    sb->delta_count++;
+}
+
+// Report local delta packed measurement buffer
+void
+sensor_bulk_delta_report(struct sensor_bulk *sb, uint8_t oid)
+{
+    sendf("sensor_bulk_delta oid=%c sequence=%hu count=%c data=%*s"
+          , oid, sb->sequence, sb->delta_count, (sb->delta_bits + 7) / 8
+          , sb->data);
+    sb->sequence += sb->delta_count * delta_factor(sb);
+    sb->delta_count = sb->delta_bits = 0;
+    memset(sb->delta_last, 0, sizeof(sb->delta_last));
+}
+
+#if CONFIG_WANT_SENSOR_BULK_DECIMATION
+// Filter samples with the given sos_filters and report every 'factor'
+// sample (only available in delta mode)
+void
+sensor_bulk_set_decimation(struct sensor_bulk *sb, uint8_t factor
+                           , uint32_t *filter_oids)
+{
+    uint_fast8_t i;
+    for (i=0; i<SENSOR_BULK_DELTA_MAX_FIELDS; i++)
+        sb->decimate_filters[i] = sos_filter_oid_lookup(filter_oids[i]);
+    sb->decimate_factor = factor;
+    sb->decimate_count = sb->decimate_error = 0;
 }
+#endif
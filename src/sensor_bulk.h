@@ -1,14 +1,31 @@
 #ifndef __SENSOR_BULK_H
 #define __SENSOR_BULK_H
 
+#define SENSOR_BULK_DELTA_MAX_FIELDS 3
+#define SENSOR_BULK_DELTA_ERROR (-0x8000)
+
 struct sensor_bulk {
     uint16_t sequence, possible_overflows;
     uint8_t data_count;
     uint8_t data[51];
+    // Delta packing state (only used after sensor_bulk_delta_reset())
+    uint8_t delta_fields, delta_sample_size, delta_count;
+    uint16_t delta_bits;
+    int16_t delta_last[SENSOR_BULK_DELTA_MAX_FIELDS];
+    // Decimation state (see sensor_bulk_set_decimation())
+    uint8_t decimate_factor, decimate_count, decimate_error;
+    struct sos_filter *decimate_filters[SENSOR_BULK_DELTA_MAX_FIELDS];
 };
 
 void sensor_bulk_reset(struct sensor_bulk *sb);
 void sensor_bulk_report(struct sensor_bulk *sb, uint8_t oid);
+void sensor_bulk_delta_reset(struct sensor_bulk *sb, uint8_t fields
+                             , uint8_t sample_size);
+void sensor_bulk_delta_add(struct sensor_bulk *sb, uint8_t oid
+                           , int16_t *values);
+void sensor_bulk_delta_report(struct sensor_bulk *sb, uint8_t oid);
+void sensor_bulk_set_decimation(struct sensor_bulk *sb, uint8_t factor
+                                , uint32_t *filter_oids);
 void sensor_bulk_status(struct sensor_bulk *sb, uint8_t oid
                         , uint32_t time1, uint32_t query_ticks, uint32_t fifo);
 
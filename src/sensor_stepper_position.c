@@ -0,0 +1,156 @@
+// Support for streaming stepper positions sampled at a fixed rate
+//
+// Copyright (C) 2026  agent <agent@local>
+//
+// This file may be distributed under the terms of the GNU GPLv3 license.
+
+#include "basecmd.h" // oid_alloc
+#include "board/irq.h" // irq_disable
+#include "command.h" // DECL_COMMAND
+#include "sched.h" // DECL_TASK
+#include "sensor_bulk.h" // sensor_bulk_report
+#include "stepper.h" // stepper_get_host_position
+
+struct stream_member {
+    struct stepper *stepper;
+    int32_t position;
+};
+
+struct stepper_position_stream {
+    struct timer timer;
+    uint32_t rest_ticks;
+    uint8_t flags, overflow, stepper_count, max_steppers;
+    struct sensor_bulk sb;
+    struct stream_member members[];
+};
+
+enum {
+    SPS_PENDING = 1<<0,
+};
+
+#define BYTES_PER_POSITION 4
+#define POSITION_ERROR 0x80000000
+
+static struct task_wake stepper_position_wake;
+
+// Event handler that samples the position of each stepper in the stream
+static uint_fast8_t
+stepper_position_event(struct timer *timer)
+{
+    struct stepper_position_stream *sps = container_of(
+        timer, struct stepper_position_stream, timer);
+    if (sps->flags & SPS_PENDING) {
+        // Previous sample not yet buffered - this sample is lost
+        sps->overflow++;
+    } else {
+        uint_fast8_t i;
+        for (i=0; i<sps->stepper_count; i++) {
+            struct stream_member *m = &sps->members[i];
+            m->position = stepper_get_host_position(m->stepper);
+        }
+        sps->flags = SPS_PENDING;
+    }
+    sched_wake_task(&stepper_position_wake);
+    sps->timer.waketime += sps->rest_ticks;
+    return SF_RESCHEDULE;
+}
+
+void
+command_config_stepper_position_stream(uint32_t *args)
+{
+    uint8_t max_steppers = args[1];
+    struct stepper_position_stream *sps = oid_alloc(
+        args[0], command_config_stepper_position_stream
+        , sizeof(*sps) + sizeof(sps->members[0]) * max_steppers);
+    if (!max_steppers
+        || max_steppers * BYTES_PER_POSITION > sizeof(sps->sb.data))
+        shutdown("Invalid stepper_position_stream stepper_count");
+    sps->max_steppers = max_steppers;
+    sps->timer.func = stepper_position_event;
+}
+DECL_COMMAND(command_config_stepper_position_stream,
+             "config_stepper_position_stream oid=%c stepper_count=%c");
+
+// Add a stepper to a position stream
+void
+command_stepper_position_stream_add(uint32_t *args)
+{
+    struct stepper_position_stream *sps = oid_lookup(
+        args[0], command_config_stepper_position_stream);
+    if (sps->stepper_count >= sps->max_steppers)
+        shutdown("Invalid stepper_position_stream member");
+    sps->members[sps->stepper_count++].stepper = stepper_oid_lookup(args[1]);
+}
+DECL_COMMAND(command_stepper_position_stream_add,
+             "stepper_position_stream_add oid=%c stepper_oid=%c");
+
+void
+command_query_stepper_position_stream(uint32_t *args)
+{
+    uint8_t oid = args[0];
+    struct stepper_position_stream *sps = oid_lookup(
+        oid, command_config_stepper_position_stream);
+
+    sched_del_timer(&sps->timer);
+    sps->flags = 0;
+    if (!args[2])
+        // End measurements
+        return;
+    if (sps->stepper_count != sps->max_steppers)
+        shutdown("stepper_position_stream not fully configured");
+
+    // Start new measurements query
+    sps->timer.waketime = args[1];
+    sps->rest_ticks = args[2];
+    sps->overflow = 0;
+    sensor_bulk_reset(&sps->sb);
+    sched_add_timer(&sps->timer);
+}
+DECL_COMMAND(command_query_stepper_position_stream,
+             "query_stepper_position_stream oid=%c clock=%u rest_ticks=%u");
+
+// Add a sample to the measurement buffer (and report it when full)
+static void
+stepper_position_add(struct stepper_position_stream *sps, uint8_t oid
+                     , int is_error)
+{
+    uint_fast8_t i, count = sps->stepper_count;
+    uint8_t *d = &sps->sb.data[sps->sb.data_count];
+    for (i=0; i<count; i++) {
+        uint32_t pos = is_error ? POSITION_ERROR : sps->members[i].position;
+        d[0] = pos;
+        d[1] = pos >> 8;
+        d[2] = pos >> 16;
+        d[3] = pos >> 24;
+        d += BYTES_PER_POSITION;
+    }
+    sps->sb.data_count += count * BYTES_PER_POSITION;
+    if (sps->sb.data_count + count * BYTES_PER_POSITION
+        > ARRAY_SIZE(sps->sb.data))
+        sensor_bulk_report(&sps->sb, oid);
+}
+
+// Background task that buffers and reports samples
+void
+stepper_position_task(void)
+{
+    if (!sched_check_wake(&stepper_position_wake))
+        return;
+    uint8_t oid;
+    struct stepper_position_stream *sps;
+    foreach_oid(oid, sps, command_config_stepper_position_stream) {
+        if (!(sps->flags & SPS_PENDING))
+            continue;
+        // Sampled positions are not updated while SPS_PENDING is set
+        stepper_position_add(sps, oid, 0);
+        irq_disable();
+        uint_fast8_t overflow = sps->overflow;
+        sps->flags = 0;
+        sps->overflow = 0;
+        irq_enable();
+        // Samples lost after the buffered sample are reported as errors
+        while (overflow--)
+            stepper_position_add(sps, oid, 1);
+    }
+}
+DECL_TASK(stepper_position_task);
@@ -5,6 +5,9 @@
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
 #include "board/gpio.h" // gpio_out_write
+#include "command.h" // DECL_ENUMERATION_RANGE
+
+DECL_ENUMERATION_RANGE("pin", "gpio0", 0, 128);
 
 struct gpio_out gpio_out_setup(uint8_t pin, uint8_t val) {
     return (struct gpio_out){.pin=pin};
@@ -0,0 +1,11 @@
+#ifndef __SIMULATOR_INTERNAL_H
+#define __SIMULATOR_INTERNAL_H
+// Local definitions for simulator code
+
+#include <stdint.h> // uint64_t
+
+// serial.c
+void serial_sleep(uint64_t nsecs);
+void serial_poll(void);
+
+#endif // internal.h
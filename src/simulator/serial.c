@@ -1,12 +1,15 @@
-// Example code for interacting with serial_irq.c
+// Simulator serial port using stdin/stdout
 //
 // Copyright (C) 2018  Kevin O'Connor <kevin@koconnor.net>
 //
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
+#define _GNU_SOURCE
 #include <fcntl.h> // fcntl
+#include <poll.h> // ppoll
 #include <unistd.h> // STDIN_FILENO
 #include "board/serial_irq.h" // serial_get_tx_byte
+#include "internal.h" // serial_poll
 #include "sched.h" // DECL_INIT
 
 void
@@ -25,26 +28,62 @@ console_receive_buffer(void)
     return NULL;
 }
 
+static uint8_t transmit_buf[64];
+static int transmit_pos, transmit_max;
+
+// Write pending transmit data to stdout
 static void
-do_uart(void)
+serial_flush_tx(void)
 {
     for (;;) {
-        uint8_t data;
-        int ret = serial_get_tx_byte(&data);
-        if (ret)
-            break;
-        else
-            write(STDOUT_FILENO, &data, sizeof(data));
-
-        // XXX - Normally the code would check if input data is
-        // available and call serial_rx_byte()
+        if (transmit_pos >= transmit_max) {
+            // Refill transmit buffer
+            transmit_pos = transmit_max = 0;
+            while (transmit_max < sizeof(transmit_buf)
+                   && !serial_get_tx_byte(&transmit_buf[transmit_max]))
+                transmit_max++;
+            if (!transmit_max)
+                return;
+        }
+        int ret = write(STDOUT_FILENO, &transmit_buf[transmit_pos]
+                        , transmit_max - transmit_pos);
+        if (ret <= 0)
+            // Output blocked - retry from serial_poll()
+            return;
+        transmit_pos += ret;
     }
 }
 
+// Sleep until serial data is available (or the timeout expires)
+void
+serial_sleep(uint64_t nsecs)
+{
+    struct pollfd fds[2] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = STDOUT_FILENO, .events = POLLOUT },
+    };
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = nsecs };
+    // Only wait for output space if transmit data is blocked
+    ppoll(fds, transmit_pos < transmit_max ? 2 : 1, &ts, NULL);
+}
+
+// Check for incoming data and retry any blocked transmit data
+void
+serial_poll(void)
+{
+    uint8_t data[64];
+    int ret = read(STDIN_FILENO, data, sizeof(data));
+    int i;
+    for (i=0; i<ret; i++)
+        serial_rx_byte(data[i]);
+    if (transmit_pos < transmit_max)
+        serial_flush_tx();
+}
+
 void
 serial_enable_tx_irq(void)
 {
-    // Normally this would enable the hardware irq, but we just call
-    // do_uart() directly in this demo code.
-    do_uart();
+    // Normally this would enable the hardware irq, but we just write
+    // the data directly in the simulator.
+    serial_flush_tx();
 }
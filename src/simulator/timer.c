@@ -5,22 +5,58 @@
 // This file may be distributed under the terms of the GNU GPLv3 license.
 
 #include <time.h> // struct timespec
-#include <unistd.h> // usleep
 #include "autoconf.h" // CONFIG_CLOCK_FREQ
 #include "board/irq.h" // irq_disable
 #include "board/misc.h" // timer_from_us
 #include "board/timer_irq.h" // timer_dispatch_many
 #include "command.h" // DECL_CONSTANT
+#include "internal.h" // serial_poll
 #include "sched.h" // DECL_INIT
 
+#define NSECS 1000000000
+#define NSECS_PER_TICK (NSECS / CONFIG_CLOCK_FREQ)
+
+// The simulator clock only advances while the process is running (or
+// sleeping in irq_wait()).  A gap between two clock reads that is
+// longer than MAX_RUN_GAP_NSECS is assumed to be a host scheduling
+// delay, and the excess is not added to the clock.  Otherwise these
+// delays would appear as timers running late and cause "Rescheduled
+// timer in the past" and "Stepper too far in past" shutdowns.  The
+// time lost this way ("lag") is recovered by skipping idle time in
+// irq_wait() up to the next timer.  The clock is thus never ahead of
+// the host clock and only falls behind it until the delayed timers
+// have run.
+#define MAX_RUN_GAP_NSECS 200000
+#define MAX_SLEEP_NSECS 100000000
+
+static struct {
+    uint64_t last_real_nsecs, clock_nsecs, max_gap_nsecs, lag_nsecs;
+} SimClock;
+
+// Return the host monotonic time in nanoseconds
+static uint64_t
+get_real_nsecs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSECS + ts.tv_nsec;
+}
+
 // Helper function that returns the system time as a 32bit counter
 static uint32_t
 get_system_time(void)
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    double t = (double)ts.tv_sec + (double)ts.tv_nsec * .000000001;
-    return (uint32_t)(t * CONFIG_CLOCK_FREQ);
+    uint64_t now = get_real_nsecs();
+    uint64_t gap = now - SimClock.last_real_nsecs;
+    if (gap > SimClock.max_gap_nsecs) {
+        SimClock.lag_nsecs += gap - SimClock.max_gap_nsecs;
+        gap = SimClock.max_gap_nsecs;
+    }
+    SimClock.last_real_nsecs = now;
+    SimClock.clock_nsecs += gap;
+    SimClock.max_gap_nsecs = MAX_RUN_GAP_NSECS;
+    // Start the counter just before zero (like a freshly reset mcu)
+    return SimClock.clock_nsecs / NSECS_PER_TICK - CONFIG_CLOCK_FREQ;
 }
 
 
@@ -54,6 +90,8 @@ do_timer_dispatch(void)
 void
 timer_init(void)
 {
+    SimClock.last_real_nsecs = get_real_nsecs();
+    SimClock.max_gap_nsecs = MAX_RUN_GAP_NSECS;
     timer_kick();
 }
 DECL_INIT(timer_init);
@@ -92,8 +130,22 @@ irq_restore(irqstatus_t flag)
 void
 irq_wait(void)
 {
-    // XXX - sleep to prevent excessive cpu usage in simulator
-    usleep(1);
+    // Sleep until the next timer or until serial data arrives
+    int32_t diff = next_wake_time - timer_read_time();
+    if (diff > 0) {
+        uint64_t nsecs = (uint64_t)diff * NSECS_PER_TICK;
+        // Skip idle time to recover lag
+        uint64_t skip = nsecs < SimClock.lag_nsecs ? nsecs : SimClock.lag_nsecs;
+        SimClock.lag_nsecs -= skip;
+        SimClock.clock_nsecs += skip;
+        nsecs -= skip;
+        if (nsecs) {
+            if (nsecs > MAX_SLEEP_NSECS)
+                nsecs = MAX_SLEEP_NSECS;
+            SimClock.max_gap_nsecs = nsecs + MAX_RUN_GAP_NSECS;
+            serial_sleep(nsecs);
+        }
+    }
 
     irq_poll();
 }
@@ -106,4 +158,5 @@ irq_poll(void)
     uint32_t now = timer_read_time();
     if (!timer_is_before(now, next_wake_time))
         do_timer_dispatch();
+    serial_poll();
 }
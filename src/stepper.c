@@ -47,6 +47,7 @@ struct stepper {
     uint32_t position;
     struct move_queue_head mq;
     struct trsync_signal stop_signal;
+    struct stepper_group *group;
     // gcc (pre v6) does better optimization when uint8_t are bitfields
     uint8_t flags : 8;
 };
@@ -248,12 +249,137 @@ DECL_COMMAND(command_config_stepper, "config_stepper oid=%c step_pin=%c"
              " dir_pin=%c invert_step=%c step_pulse_ticks=%u");
 
 // Return the 'struct stepper' for a given stepper oid
-static struct stepper *
+struct stepper *
 stepper_oid_lookup(uint8_t oid)
 {
     return oid_lookup(oid, command_config_stepper);
 }
 
+// A stepper group runs the step events of several steppers from a
+// single timer.  The step events of group members that are due within
+// 'tolerance_ticks' of each other are run in the same timer dispatch.
+struct stepper_group {
+    struct timer time;
+    uint32_t tolerance_ticks;
+    uint8_t stepper_count, max_steppers, flags;
+    struct stepper *steppers[];
+};
+
+enum { GF_ACTIVE=1<<0 };
+
+// Make sure the group timer runs no later than a newly started stepper
+static void
+stepper_group_wake(struct stepper_group *g, uint32_t waketime)
+{
+    if (g->flags & GF_ACTIVE) {
+        if (!timer_is_before(waketime, g->time.waketime))
+            return;
+        sched_del_timer(&g->time);
+    }
+    g->flags |= GF_ACTIVE;
+    g->time.waketime = waketime;
+    sched_add_timer(&g->time);
+}
+
+#if CONFIG_WANT_STEPPER_GROUP
+// Run the next event of a stepper that is a member of a group
+static inline uint_fast8_t
+stepper_group_step(struct stepper *s)
+{
+    if (CONFIG_INLINE_STEPPER_HACK && likely(!s->time.func))
+        return stepper_event(&s->time);
+    return s->time.func(&s->time);
+}
+
+// Check if the next event of a group member is a step (and not an
+// unstep or a "step on both edges" toggle)
+static inline int
+stepper_can_run_early(struct stepper *s)
+{
+    if (s->flags & SF_SINGLE_SCHED)
+        // Only the avr optimized path does a full step per event
+        return HAVE_AVR_OPTIMIZATION && s->flags & SF_OPTIMIZED_PATH;
+    return !(s->count & 1);
+}
+
+// Timer callback for a group of steppers
+static uint_fast8_t
+stepper_group_event(struct timer *t)
+{
+    struct stepper_group *g = container_of(t, struct stepper_group, time);
+    uint32_t waketime = g->time.waketime;
+    uint32_t early_time = waketime + g->tolerance_ticks, next_waketime = 0;
+    uint_fast8_t i, have_next = 0;
+    for (i=0; i<g->stepper_count; i++) {
+        struct stepper *s = g->steppers[i];
+        if (!s->count)
+            continue;
+        uint32_t s_waketime = s->time.waketime;
+        // Step events may be run early, but unstep events must not be
+        // (that would shorten the step pulse).  With "step on both
+        // edges" every event is a pin toggle, so none may be run early.
+        if (!timer_is_before(waketime, s_waketime)
+            || (!timer_is_before(early_time, s_waketime)
+                && stepper_can_run_early(s))) {
+            if (stepper_group_step(s) == SF_DONE)
+                continue;
+            s_waketime = s->time.waketime;
+        }
+        if (!have_next || timer_is_before(s_waketime, next_waketime)) {
+            next_waketime = s_waketime;
+            have_next = 1;
+        }
+    }
+    if (!have_next) {
+        g->flags &= ~GF_ACTIVE;
+        return SF_DONE;
+    }
+    g->time.waketime = next_waketime;
+    return SF_RESCHEDULE;
+}
+
+void
+command_config_stepper_group(uint32_t *args)
+{
+    uint8_t max_steppers = args[1];
+    struct stepper_group *g = oid_alloc(
+        args[0], command_config_stepper_group
+        , sizeof(*g) + sizeof(g->steppers[0]) * max_steppers);
+    g->max_steppers = max_steppers;
+    g->tolerance_ticks = args[2];
+    g->time.func = stepper_group_event;
+}
+DECL_COMMAND(command_config_stepper_group, "config_stepper_group oid=%c"
+             " stepper_count=%c tolerance_ticks=%u");
+
+// Add a stepper to a group (must be done before the stepper is used)
+void
+command_stepper_group_add(uint32_t *args)
+{
+    struct stepper_group *g = oid_lookup(args[0]
+                                         , command_config_stepper_group);
+    struct stepper *s = stepper_oid_lookup(args[1]);
+    if (g->stepper_count >= g->max_steppers || s->group || s->count)
+        shutdown("Invalid stepper group member");
+    g->steppers[g->stepper_count++] = s;
+    s->group = g;
+}
+DECL_COMMAND(command_stepper_group_add,
+             "stepper_group_add oid=%c stepper_oid=%c");
+
+void
+stepper_group_shutdown(void)
+{
+    // The scheduler removes all timers on a shutdown
+    uint8_t i;
+    struct stepper_group *g;
+    foreach_oid(i, g, command_config_stepper_group) {
+        g->flags = 0;
+    }
+}
+DECL_SHUTDOWN(stepper_group_shutdown);
+#endif
+
 // Schedule a set of steps with a given timing
 void
 command_queue_step(uint32_t *args)
@@ -282,12 +408,15 @@ command_queue_step(uint32_t *args)
         s->flags = flags;
         move_queue_push(&m->node, &s->mq);
         stepper_load_next(s);
-        sched_add_timer(&s->time);
+        if (CONFIG_WANT_STEPPER_GROUP && s->group)
+            stepper_group_wake(s->group, s->time.waketime);
+        else
+            sched_add_timer(&s->time);
     }
     irq_enable();
 }
-DECL_COMMAND(command_queue_step,
-             "queue_step oid=%c interval=%u count=%hu add=%hi");
+DECL_COMMAND_FAST(command_queue_step,
+                  "queue_step oid=%c interval=%u count=%hu add=%hi");
 
 // Set the direction of the next queued step
 void
@@ -299,7 +428,8 @@ command_set_next_step_dir(uint32_t *args)
     s->flags = (s->flags & ~SF_NEXT_DIR) | nextdir;
     irq_enable();
 }
-DECL_COMMAND(command_set_next_step_dir, "set_next_step_dir oid=%c dir=%c");
+DECL_COMMAND_FAST(command_set_next_step_dir,
+                  "set_next_step_dir oid=%c dir=%c");
 
 // Set an absolute time that the next step will be relative to
 void
@@ -345,6 +475,13 @@ command_stepper_get_position(uint32_t *args)
 }
 DECL_COMMAND(command_stepper_get_position, "stepper_get_position oid=%c");
 
+// Return the stepper position in host units.  Caller must disable irqs.
+int32_t
+stepper_get_host_position(struct stepper *s)
+{
+    return stepper_get_position(s) - POSITION_BIAS;
+}
+
 // Stop all moves for a given stepper (caller must disable IRQs)
 static void
 stepper_stop(struct trsync_signal *tss, uint8_t reason)
@@ -4,5 +4,7 @@
 #include <stdint.h> // uint8_t
 
 uint_fast8_t stepper_event(struct timer *t);
+struct stepper *stepper_oid_lookup(uint8_t oid);
+int32_t stepper_get_host_position(struct stepper *s);
 
 #endif // stepper.h
@@ -0,0 +1,56 @@
+# Check the binary data format of bulk sensor webhooks clients
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os, json, struct
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', '..', 'klippy'))
+import webhooks
+from extras import bulk_sensor
+
+# A client connection that stores the messages sent to it
+class FakeClientConnection(webhooks.ClientConnection):
+    def __init__(self):
+        self.fd_handle = self.uid = 1
+        self.is_blocking = False
+        self.printer = None
+        self.send_buffer = b""
+    def _do_send(self, eventtime=None):
+        pass
+
+def main():
+    cconn = FakeClientConnection()
+    request = {'id': 1, 'method': 'motion_report/dump_trapq',
+               'params': {'name': 'toolhead', 'data_format': 'binary',
+                          'response_template': {'key': 123}}}
+    web_request = webhooks.WebRequest(cconn, json.dumps(request).encode())
+    client = bulk_sensor.BatchWebhooksClient(web_request)
+    rows = [(1.0, 0.5, 0.0, 10.0, (1., 2., 3.), (.6, .8, 0.)),
+            (1.5, 0.25, -5.0, 12.5, (4., 5., 6.), (0., 0., 1.))]
+    client.handle_batch({'data': rows})
+    # Decode the header and then read the binary data by length
+    data = cconn.send_buffer
+    hdr_end = data.index(b"\x03")
+    hdr = json.loads(data[:hdr_end].decode())
+    size = hdr['binary_size']
+    payload = data[hdr_end+1:hdr_end+1+size]
+    errors = []
+    if data[hdr_end+1+size:] != b"\x03":
+        errors.append("Binary data is not followed by a terminator")
+    if hdr.get('key') != 123:
+        errors.append("Response template not used: %s" % (hdr,))
+    desc = hdr['params']['data']
+    if desc != {'type': 'float64', 'rows': 2, 'columns': 10}:
+        errors.append("Unexpected data description %s" % (desc,))
+    values = list(struct.unpack('<%dd' % (size // 8,), payload))
+    expected = [1.0, 0.5, 0.0, 10.0, 1., 2., 3., .6, .8, 0.,
+                1.5, 0.25, -5.0, 12.5, 4., 5., 6., 0., 0., 1.]
+    if values != expected:
+        errors.append("Decoded %s (expected %s)" % (values, expected))
+    if errors:
+        sys.stderr.write("\n".join(errors) + "\n")
+        sys.exit(-1)
+
+if __name__ == '__main__':
+    main()
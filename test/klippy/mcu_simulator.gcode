@@ -0,0 +1,68 @@
+; Stepping workload for scripts/mcu_simulator.py --check
+SET_KINEMATIC_POSITION X=100 Y=100 Z=10
+G1 Z12 F600
+G1 X120.000 Y100.000 F12000
+G1 X129.344 Y106.237 F6000
+G1 X136.542 Y116.269 F12000
+G1 X140.451 Y129.389 F6000
+G1 X113.383 Y114.863 F12000
+G1 X115.000 Y125.981 F6000
+G1 X112.361 Y138.042 F12000
+G1 X105.226 Y149.726 F6000
+G1 X97.909 Y119.890 F12000
+G1 X90.729 Y128.532 F6000
+G1 X80.000 Y134.641 F12000
+G1 X66.543 Y137.157 F6000
+G1 X83.820 Y111.756 F12000
+G1 X72.594 Y112.202 F6000
+G1 X60.874 Y108.316 F12000
+G1 Z10.0 F600
+G1 X50.000 Y100.000 F6000
+G1 X80.437 Y95.842 F12000
+G1 X72.594 Y87.798 F6000
+G1 X67.639 Y76.489 F12000
+G1 X66.543 Y62.843 F6000
+G1 X90.000 Y82.679 F12000
+G1 X90.729 Y71.468 F6000
+G1 X95.819 Y60.219 F12000
+G1 X105.226 Y50.274 F6000
+G1 X106.180 Y80.979 F12000
+G1 X115.000 Y74.019 F6000
+G1 X126.765 Y70.274 F12000
+G1 X140.451 Y70.611 F6000
+G1 X118.271 Y91.865 F12000
+G1 X129.344 Y93.763 F6000
+G1 Z12.0 F600
+G1 X140.000 Y100.000 F12000
+G1 X148.907 Y110.396 F6000
+G1 X118.271 Y108.135 F12000
+G1 X124.271 Y117.634 F6000
+G1 X126.765 Y129.726 F12000
+G1 X125.000 Y143.301 F6000
+G1 X106.180 Y119.021 F12000
+G1 X103.136 Y129.836 F6000
+G1 X95.819 Y139.781 F12000
+G1 X84.549 Y147.553 F6000
+G1 X90.000 Y117.321 F12000
+G1 X79.926 Y122.294 F6000
+G1 X67.639 Y123.511 F12000
+G1 X54.323 Y120.337 F6000
+G1 X80.437 Y104.158 F12000
+G1 Z10.0 F600
+G1 X70.000 Y100.000 F6000
+G1 X60.874 Y91.684 F12000
+G1 X54.323 Y79.663 F6000
+G1 X83.820 Y88.244 F12000
+G1 X79.926 Y77.706 F6000
+G1 X80.000 Y65.359 F12000
+G1 X84.549 Y52.447 F6000
+G1 X97.909 Y80.110 F12000
+G1 X103.136 Y70.164 F6000
+G1 X112.361 Y61.958 F12000
+G1 X125.000 Y56.699 F6000
+G1 X113.383 Y85.137 F12000
+G1 X124.271 Y82.366 F6000
+G1 X136.542 Y83.731 F12000
+G1 X148.907 Y89.604 F6000
+G1 Z12.0 F600
+G1 X100 Y100 Z10 F6000
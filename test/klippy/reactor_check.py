@@ -0,0 +1,65 @@
+# Check the ordering of reactor timer callbacks
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', '..', 'klippy'))
+import reactor
+
+# A timer that always reschedules itself at NOW must not prevent other
+# due timers from running
+def check_repeating_timer():
+    r = reactor.Reactor()
+    log = []
+    def timer_a(eventtime):
+        log.append('A')
+        if len(log) >= 7:
+            r.end()
+            return r.NEVER
+        return r.NOW
+    def timer_b(eventtime):
+        log.append('B')
+        return r.NEVER
+    r.register_timer(timer_a, r.NOW)
+    r.register_timer(timer_b, r.monotonic())
+    r.run()
+    r.finalize()
+    if ''.join(log) != 'ABAAAAA':
+        return ["Repeating timer ran as %s (expected ABAAAAA)" % (
+            ''.join(log),)]
+    return []
+
+# A timer added during a pass must still run while a later callback in
+# that pass pauses
+def check_pause():
+    r = reactor.Reactor()
+    log = []
+    def timer_added(eventtime):
+        log.append('added')
+        return r.NEVER
+    def timer_add(eventtime):
+        r.register_timer(timer_added, r.NOW)
+        return r.NEVER
+    def timer_pause(eventtime):
+        r.pause(r.monotonic() + 0.050)
+        log.append('paused')
+        r.end()
+        return r.NEVER
+    r.register_timer(timer_add, r.NOW)
+    r.register_timer(timer_pause, r.NOW)
+    r.run()
+    r.finalize()
+    if log != ['added', 'paused']:
+        return ["Timer added before a pause ran as %s" % (log,)]
+    return []
+
+def main():
+    errors = check_repeating_timer() + check_pause()
+    if errors:
+        sys.stderr.write("\n".join(errors) + "\n")
+        sys.exit(-1)
+
+if __name__ == '__main__':
+    main()
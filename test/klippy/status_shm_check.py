@@ -0,0 +1,37 @@
+# Check the status file written by status_shm.test
+#
+# Copyright (C) 2026  agent <agent@local>
+#
+# This file may be distributed under the terms of the GNU GPLv3 license.
+import sys, os
+sys.path.append(os.path.join(os.path.dirname(os.path.realpath(__file__)),
+                             '..', '..', 'scripts'))
+import shmstatus
+
+def main():
+    status = shmstatus.StatusReader(sys.argv[1]).read()
+    sys.stderr.write("Status file contents: %s\n" % (status,))
+    errors = []
+    def check(desc, value, expected):
+        if value != expected:
+            errors.append("%s is %s (expected %s)" % (desc, value, expected))
+    # Klippy has exited, so the final update reports a disconnect
+    check("printer_state", status['printer_state'], 'disconnected')
+    check("print_state", status['print_state'], 'standby')
+    check("heaters", sorted(status['heaters']),
+          ['heater_generic test_heater'])
+    check("mcus", sorted(status['mcus']), ['mcu'])
+    check("target", status['heaters']['heater_generic test_heater']['target'],
+          0.)
+    # Each update increments the sequence by two (there must be at least
+    # one periodic update and the final disconnect update)
+    if status['sequence'] < 4 or status['sequence'] & 1:
+        errors.append("Unexpected sequence %d" % (status['sequence'],))
+    if status['update_time'] <= 0.:
+        errors.append("Status was never updated")
+    if errors:
+        sys.stderr.write("\n".join(errors) + "\n")
+        sys.exit(-1)
+
+if __name__ == '__main__':
+    main()